@@ -1,6 +1,8 @@
 ﻿#pragma once
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 
 namespace Constants
 {
@@ -12,10 +14,10 @@ template<class AllocatorType = std::allocator<uint8_t>>
 class BooleanVector
 {
 private:
-    uint8_t* _buckets;
-    size_t _size; //пази стойностите на всички булеви стойности тоест = bucketsCount * 8
-    size_t _bucketsCount;
-    size_t _capacity; //пази всички възможни битове от заделената памет
+    uint8_t* _buckets = nullptr;
+    size_t _size = 0; //пази стойностите на всички булеви стойности тоест = bucketsCount * 8
+    size_t _bucketsCount = 0;
+    size_t _capacity = 0; //пази всички възможни битове от заделената памет
 
     AllocatorType allocator;
 
@@ -32,6 +34,7 @@ private:
 public:
     BooleanVector() = default;
     explicit BooleanVector(size_t count);
+    BooleanVector(size_t count, bool value); //count стойности, равни на value
 
     BooleanVector(const BooleanVector& other);
     BooleanVector& operator=(const BooleanVector& other);
@@ -51,6 +54,12 @@ public:
     bool operator[](size_t index);
     bool operator[](size_t index) const;
 
+    void set(size_t index, bool value);
+
+    //Индексът на първия вдигнат бит, по-голям или равен на from, или size(), ако няма такъв.
+    //Нулевите бъкети се прескачат по 8 наведнъж.
+    size_t find_next(size_t from) const;
+
     size_t size() const;
     size_t capacity() const;
     bool empty() const;
@@ -444,8 +453,8 @@ public:
         this->_bucketsCount = other._bucketsCount;
 
         _buckets = allocator.allocate(_bucketsCount);
-        for (int i = 0; i < _bucketsCount; i++)
-            push_back(other[i]);
+        if (_bucketsCount > 0)
+            std::memcpy(_buckets, other._buckets, _bucketsCount);
     }
 
     template<class AllocatorType>
@@ -503,6 +512,20 @@ public:
             _buckets[i] = 0;
     }
 
+    template<class AllocatorType>
+    BooleanVector<AllocatorType>::BooleanVector(size_t count, bool value)
+        : _size(count),
+        _bucketsCount(count / Constants::elementsInBucket + 1),
+        _capacity(_bucketsCount * Constants::elementsInBucket)
+    {
+        _buckets = allocator.allocate(_bucketsCount);
+        std::memset(_buckets, value ? 0xFF : 0, _bucketsCount);
+
+        //битовете след последния елемент остават нули, както при push_back
+        if (value)
+            _buckets[_bucketsCount - 1] &= static_cast<uint8_t>((1 << getBitIndex(count)) - 1);
+    }
+
     template<class AllocatorType>
     BooleanVector<AllocatorType>::BooleanVector(const BooleanVector& other)
     {
@@ -634,6 +657,52 @@ public:
         return _buckets[bucketIndex] & mask;
     }
 
+    template<class AllocatorType>
+    void BooleanVector<AllocatorType>::set(size_t index, bool value)
+    {
+        if (index >= _size)
+            throw std::out_of_range("Reaching outside the vector's size");
+
+        uint8_t mask = (1 << getBitIndex(index));
+        if (value)
+            _buckets[getBucketIndex(index)] |= mask;
+        else
+            _buckets[getBucketIndex(index)] &= ~mask;
+    }
+
+    template<class AllocatorType>
+    size_t BooleanVector<AllocatorType>::find_next(size_t from) const
+    {
+        if (from >= _size)
+            return _size;
+
+        size_t bucketIndex = getBucketIndex(from);
+        uint8_t current = _buckets[bucketIndex] & static_cast<uint8_t>(0xFF << getBitIndex(from));
+        while (current == 0)
+        {
+            bucketIndex++;
+            while (bucketIndex + sizeof(uint64_t) <= _bucketsCount)
+            {
+                uint64_t word;
+                std::memcpy(&word, _buckets + bucketIndex, sizeof(uint64_t));
+                if (word != 0)
+                    break;
+                bucketIndex += sizeof(uint64_t);
+            }
+
+            if (bucketIndex >= _bucketsCount)
+                return _size;
+            current = _buckets[bucketIndex];
+        }
+
+        unsigned bitIndex = 0;
+        while (!(current & (1 << bitIndex)))
+            bitIndex++;
+
+        size_t index = bucketIndex * Constants::elementsInBucket + bitIndex;
+        return index < _size ? index : _size;
+    }
+
     template<class AllocatorType>
     size_t BooleanVector<AllocatorType>::size() const
     {
@@ -0,0 +1,320 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//Множество от низове с отворено адресиране (linear probing) и 16-байтови слотове.
+//Низ до 8 байта се пази в самия слот, по-дългите се копират един след друг в блокове от по 64KB (арена)
+//и слотът пази номера на блока и отместването в него. Така няма отделно заделяне на памет за всеки ключ,
+//а при растеж на арената старите ключове не се копират.
+//Индексът в таблицата се смята само от 32-битовия хеш в слота, затова преоразмеряването не чете низовете.
+//Изтриването измества следващите слотове назад (backward shift) и не оставя tombstone-и.
+class ArenaStringSet
+{
+private:
+	static constexpr uint32_t EMPTY = UINT32_MAX; //length на празен слот
+	static constexpr size_t INLINE_CAPACITY = 8;
+	static constexpr size_t MIN_CAPACITY = 16;
+	static constexpr double MAX_LOAD_FACTOR = 0.8;
+	static constexpr size_t MIN_COMPACTION_BYTES = 4096;
+	static constexpr unsigned CHUNK_BITS = 16;
+	static constexpr size_t CHUNK_SIZE = static_cast<size_t>(1) << CHUNK_BITS; //по-дълъг ключ получава собствен блок
+
+	struct Slot
+	{
+		uint32_t hash;
+		uint32_t length;
+		union
+		{
+			uint64_t offset; //(номер на блок << CHUNK_BITS) | отместване в блока
+			char inlined[INLINE_CAPACITY];
+		};
+	};
+	static_assert(sizeof(Slot) == 16, "Slot must stay 16 bytes");
+
+	struct Chunk
+	{
+		std::unique_ptr<char[]> data;
+		size_t capacity;
+	};
+
+	std::vector<Slot> slots; //размерът е степен на двойката
+	std::vector<Chunk> arena;
+	size_t currentChunk = SIZE_MAX; //блокът, в който се добавят ключове
+	size_t currentChunkUsed = 0;
+	size_t arenaBytes = 0; //байтове, заети от ключове (живи и изтрити)
+	size_t elementsCount = 0;
+	size_t deadArenaBytes = 0; //байтове на изтрити ключове, които още стоят в арената
+	unsigned shift = 64 - 4;
+
+	static uint32_t hashOf(std::string_view key);
+	size_t homeIndex(uint32_t hash) const;
+	size_t nextIndex(size_t index) const;
+
+	std::string_view keyOf(const Slot& slot) const;
+	uint64_t storeInArena(std::vector<Chunk>& chunks, std::string_view key); //връща offset за слота
+	bool matches(const Slot& slot, uint32_t hash, std::string_view key) const;
+
+	//Индексът на ключа, или на първия празен слот по пътя му
+	size_t probe(uint32_t hash, std::string_view key) const;
+
+	void resize(size_t newCapacity);
+	void compactArena();
+public:
+	ArenaStringSet();
+
+	bool insert(std::string_view key);
+	bool remove(std::string_view key);
+	bool contains(std::string_view key) const;
+	size_t count(std::string_view key) const;
+
+	template<typename Function>
+	void for_each(const Function& func) const; //func(std::string_view)
+
+	void clear();
+	void reserve(size_t elements);
+
+	size_t size() const;
+	bool empty() const;
+	double loadFactor() const;
+
+	//Байтове, заявени от алокатора: обектът, слотовете и блоковете на арената
+	size_t memory_usage() const;
+};
+
+inline uint32_t ArenaStringSet::hashOf(std::string_view key)
+{
+	uint64_t h = std::hash<std::string_view>()(key);
+	return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+inline size_t ArenaStringSet::homeIndex(uint32_t hash) const
+{
+	//Fibonacci hashing - както в PowerOfTwoBucketPolicy
+	return static_cast<size_t>((static_cast<uint64_t>(hash) * 11400714819323198485ull) >> shift);
+}
+
+inline size_t ArenaStringSet::nextIndex(size_t index) const
+{
+	return (index + 1) & (slots.size() - 1);
+}
+
+inline std::string_view ArenaStringSet::keyOf(const Slot& slot) const
+{
+	if (slot.length <= INLINE_CAPACITY)
+		return std::string_view(slot.inlined, slot.length);
+
+	const Chunk& chunk = arena[slot.offset >> CHUNK_BITS];
+	return std::string_view(chunk.data.get() + (slot.offset & (CHUNK_SIZE - 1)), slot.length);
+}
+
+inline uint64_t ArenaStringSet::storeInArena(std::vector<Chunk>& chunks, std::string_view key)
+{
+	if (key.size() > CHUNK_SIZE)
+	{
+		chunks.push_back({ std::make_unique<char[]>(key.size()), key.size() });
+		std::memcpy(chunks.back().data.get(), key.data(), key.size());
+		arenaBytes += key.size();
+		return static_cast<uint64_t>(chunks.size() - 1) << CHUNK_BITS;
+	}
+
+	if (currentChunk >= chunks.size() || currentChunkUsed + key.size() > CHUNK_SIZE)
+	{
+		chunks.push_back({ std::make_unique<char[]>(CHUNK_SIZE), CHUNK_SIZE });
+		currentChunk = chunks.size() - 1;
+		currentChunkUsed = 0;
+	}
+
+	uint64_t offset = (static_cast<uint64_t>(currentChunk) << CHUNK_BITS) | currentChunkUsed;
+	std::memcpy(chunks[currentChunk].data.get() + currentChunkUsed, key.data(), key.size());
+	currentChunkUsed += key.size();
+	arenaBytes += key.size();
+	return offset;
+}
+
+inline bool ArenaStringSet::matches(const Slot& slot, uint32_t hash, std::string_view key) const
+{
+	return slot.hash == hash && slot.length == key.size() && keyOf(slot) == key;
+}
+
+inline size_t ArenaStringSet::probe(uint32_t hash, std::string_view key) const
+{
+	size_t index = homeIndex(hash);
+	while (slots[index].length != EMPTY && !matches(slots[index], hash, key))
+		index = nextIndex(index);
+	return index;
+}
+
+inline void ArenaStringSet::resize(size_t newCapacity)
+{
+	std::vector<Slot> oldSlots = std::move(slots);
+	slots.assign(newCapacity, Slot());
+	for (Slot& slot : slots)
+		slot.length = EMPTY;
+
+	unsigned bits = 0;
+	while ((static_cast<size_t>(1) << bits) < newCapacity)
+		bits++;
+	shift = 64 - bits;
+
+	for (const Slot& slot : oldSlots)
+	{
+		if (slot.length == EMPTY)
+			continue;
+
+		size_t index = homeIndex(slot.hash);
+		while (slots[index].length != EMPTY)
+			index = nextIndex(index);
+		slots[index] = slot;
+	}
+}
+
+inline void ArenaStringSet::compactArena()
+{
+	std::vector<Chunk> newArena;
+	currentChunk = SIZE_MAX;
+	arenaBytes = 0;
+	for (Slot& slot : slots)
+	{
+		if (slot.length == EMPTY || slot.length <= INLINE_CAPACITY)
+			continue;
+
+		slot.offset = storeInArena(newArena, keyOf(slot));
+	}
+	arena.swap(newArena);
+	deadArenaBytes = 0;
+}
+
+inline ArenaStringSet::ArenaStringSet()
+{
+	resize(MIN_CAPACITY);
+}
+
+inline bool ArenaStringSet::insert(std::string_view key)
+{
+	uint32_t hash = hashOf(key);
+	size_t index = probe(hash, key);
+	if (slots[index].length != EMPTY)
+		return false;
+
+	if (elementsCount + 1 > MAX_LOAD_FACTOR * slots.size())
+	{
+		resize(slots.size() * 2);
+		index = probe(hash, key);
+	}
+
+	Slot& slot = slots[index];
+	slot.hash = hash;
+	slot.length = static_cast<uint32_t>(key.size());
+	if (key.size() <= INLINE_CAPACITY)
+	{
+		std::memset(slot.inlined, 0, INLINE_CAPACITY);
+		std::memcpy(slot.inlined, key.data(), key.size());
+	}
+	else
+		slot.offset = storeInArena(arena, key);
+
+	elementsCount++;
+	return true;
+}
+
+inline bool ArenaStringSet::remove(std::string_view key)
+{
+	size_t index = probe(hashOf(key), key);
+	if (slots[index].length == EMPTY)
+		return false;
+
+	if (slots[index].length > INLINE_CAPACITY)
+		deadArenaBytes += slots[index].length;
+
+	//следващите слотове от същата верига се местят назад, докато не стигнем празен
+	//или слот, който вече е на или след своя начален индекс спрямо дупката
+	size_t hole = index;
+	size_t curr = nextIndex(index);
+	while (slots[curr].length != EMPTY)
+	{
+		size_t home = homeIndex(slots[curr].hash);
+		size_t distanceToCurr = (curr - home) & (slots.size() - 1);
+		size_t distanceToHole = (hole - home) & (slots.size() - 1);
+		if (distanceToHole < distanceToCurr)
+		{
+			slots[hole] = slots[curr];
+			hole = curr;
+		}
+		curr = nextIndex(curr);
+	}
+	slots[hole].length = EMPTY;
+	elementsCount--;
+
+	if (deadArenaBytes > MIN_COMPACTION_BYTES && deadArenaBytes * 2 > arenaBytes)
+		compactArena();
+	return true;
+}
+
+inline bool ArenaStringSet::contains(std::string_view key) const
+{
+	return slots[probe(hashOf(key), key)].length != EMPTY;
+}
+
+inline size_t ArenaStringSet::count(std::string_view key) const
+{
+	return contains(key) ? 1 : 0;
+}
+
+template<typename Function>
+void ArenaStringSet::for_each(const Function& func) const
+{
+	for (const Slot& slot : slots)
+	{
+		if (slot.length != EMPTY)
+			func(keyOf(slot));
+	}
+}
+
+inline void ArenaStringSet::clear()
+{
+	std::vector<Slot>().swap(slots);
+	std::vector<Chunk>().swap(arena);
+	currentChunk = SIZE_MAX;
+	arenaBytes = 0;
+	elementsCount = 0;
+	deadArenaBytes = 0;
+	resize(MIN_CAPACITY);
+}
+
+inline void ArenaStringSet::reserve(size_t elements)
+{
+	size_t capacity = slots.size();
+	while (elements > MAX_LOAD_FACTOR * capacity)
+		capacity *= 2;
+
+	if (capacity != slots.size())
+		resize(capacity);
+}
+
+inline size_t ArenaStringSet::size() const
+{
+	return elementsCount;
+}
+
+inline bool ArenaStringSet::empty() const
+{
+	return elementsCount == 0;
+}
+
+inline double ArenaStringSet::loadFactor() const
+{
+	return static_cast<double>(elementsCount) / slots.size();
+}
+
+inline size_t ArenaStringSet::memory_usage() const
+{
+	size_t bytes = sizeof(*this) + slots.capacity() * sizeof(Slot) + arena.capacity() * sizeof(Chunk);
+	for (const Chunk& chunk : arena)
+		bytes += chunk.capacity;
+	return bytes;
+}
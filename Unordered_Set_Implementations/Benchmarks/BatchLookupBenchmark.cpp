@@ -0,0 +1,83 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include "../UnorderedSet.hpp"
+
+//contains_batch срещу цикъл от единични find.
+//Топъл кеш - 4K ключа, студен - 8M ключа. Заявките са 4M uint64_t, наполовина попадения и наполовина пропуски.
+//Отчита се най-доброто от 5 пускания.
+//Топлата таблица е под BATCH_PREFETCH_MIN_BYTES и contains_batch минава през обикновеното търсене, така че там се очаква 1.0x.
+//Компилиране: g++ -std=c++17 -O2 -I.. BatchLookupBenchmark.cpp
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Function>
+double measureMs(const Function& func)
+{
+	Clock::time_point start = Clock::now();
+	func();
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void runBenchmark(const char* label, size_t keysCount, size_t queriesCount)
+{
+	std::mt19937_64 rng(1);
+	UnorderedSet<uint64_t> set;
+	set.reserve(keysCount);
+
+	std::vector<uint64_t> keys(keysCount);
+	for (uint64_t& key : keys)
+	{
+		key = rng();
+		set.insert(key);
+	}
+
+	std::vector<uint64_t> queries(queriesCount);
+	for (size_t i = 0; i < queriesCount; i++)
+		queries[i] = i % 2 ? keys[rng() % keysCount] : rng();
+
+	std::unique_ptr<bool[]> singleMask(new bool[queriesCount]);
+	std::unique_ptr<bool[]> batchMask(new bool[queriesCount]);
+	auto singleFind = [&]() {
+		for (size_t i = 0; i < queriesCount; i++)
+			singleMask[i] = set.find(queries[i]) != set.cend();
+	};
+	auto batchFind = [&]() {
+		set.contains_batch(queries.data(), queriesCount, batchMask.get());
+	};
+
+	//първото пускане само загрява кода и TLB-то
+	singleFind();
+	batchFind();
+
+	double bestSingle = 1e18, bestBatch = 1e18;
+	for (int run = 0; run < 5; run++)
+	{
+		bestSingle = std::min(bestSingle, measureMs(singleFind));
+		bestBatch = std::min(bestBatch, measureMs(batchFind));
+	}
+
+	for (size_t i = 0; i < queriesCount; i++)
+	{
+		if (singleMask[i] != batchMask[i])
+		{
+			std::printf("%s: contains_batch differs from find at query %zu\n", label, i);
+			std::exit(1);
+		}
+	}
+
+	std::printf("%s, %zu keys, %zu queries: find loop %.1f ms, contains_batch %.1f ms (%.2fx)\n",
+		label, keysCount, queriesCount, bestSingle, bestBatch, bestSingle / bestBatch);
+}
+
+int main()
+{
+	runBenchmark("warm", static_cast<size_t>(1) << 12, static_cast<size_t>(1) << 22);
+	runBenchmark("cold", static_cast<size_t>(1) << 23, static_cast<size_t>(1) << 22);
+	return 0;
+}
@@ -0,0 +1,101 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "../UnorderedSet.hpp"
+
+//Цена на индексирането при различните политики за бъкети.
+//ModuloBucketPolicy е старият начин (64-битово деление) и служи само за сравнение.
+//	- топъл кеш: 4096 случайни ключа, 2000 обхождания с наполовина попадения;
+//	- ключове през 64: 1M ключа i * 64 с идентитета std::hash - модулът ги групира по бъкети.
+//Мери се само търсенето - добавянето е еднакво скъпо при всички политики заради заделянето на възли.
+//Отчита се най-доброто от 5 пускания.
+//Очаквано: при топъл кеш простото число е наравно с делението или по-бавно - то печели само при ключовете през 64.
+//Компилиране: g++ -std=c++17 -O2 -I.. BucketPolicyBenchmark.cpp
+
+using Clock = std::chrono::steady_clock;
+
+class ModuloBucketPolicy
+{
+private:
+	size_t count = BucketPolicyConstants::MIN_BUCKETS_COUNT;
+public:
+	static size_t roundBucketsCount(size_t minCount)
+	{
+		return PowerOfTwoBucketPolicy::roundBucketsCount(minCount);
+	}
+
+	void setBucketsCount(size_t _count)
+	{
+		count = _count;
+	}
+
+	size_t index(size_t hash) const
+	{
+		return hash % count;
+	}
+};
+
+template<typename Function>
+double measureMs(const Function& func)
+{
+	Clock::time_point start = Clock::now();
+	func();
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+template<typename BucketPolicy>
+void runBenchmark(const char* label)
+{
+	using Set = UnorderedSet<uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, BucketPolicy>;
+
+	std::mt19937_64 rng(3);
+	std::vector<uint64_t> randomKeys(4096);
+	for (uint64_t& key : randomKeys)
+		key = rng();
+
+	Set warmSet;
+	for (uint64_t key : randomKeys)
+		warmSet.insert(key);
+
+	size_t hits = 0;
+	auto warmLookups = [&]() {
+		for (int round = 0; round < 2000; round++)
+		{
+			for (uint64_t key : randomKeys)
+				hits += warmSet.contains(key + (round & 1));
+		}
+	};
+
+	Set stridedSet;
+	for (uint64_t i = 0; i < 1000000; i++)
+		stridedSet.insert(i * 64);
+
+	auto stridedLookups = [&]() {
+		for (int round = 0; round < 5; round++)
+		{
+			for (uint64_t i = 0; i < 1000000; i++)
+				hits += stridedSet.contains(i * 64 + (round & 1));
+		}
+	};
+
+	double warmMs = 1e18, stridedMs = 1e18;
+	for (int run = 0; run < 5; run++)
+	{
+		warmMs = std::min(warmMs, measureMs(warmLookups));
+		stridedMs = std::min(stridedMs, measureMs(stridedLookups));
+	}
+
+	std::printf("%-20s 8.2M warm lookups %.0f ms, 5M stride 64 lookups %.0f ms (%zu)\n", label, warmMs, stridedMs, hits);
+}
+
+int main()
+{
+	runBenchmark<ModuloBucketPolicy>("64-bit modulo");
+	runBenchmark<PowerOfTwoBucketPolicy>("pow2 + Fibonacci");
+	runBenchmark<PrimeBucketPolicy>("prime + fastmod");
+	return 0;
+}
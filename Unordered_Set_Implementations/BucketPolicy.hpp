@@ -0,0 +1,103 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+//Политиките определят допустимите брой бъкети и как хешът се превръща в индекс на бъкет.
+//Интерфейс:
+//	static size_t roundBucketsCount(size_t minCount) - най-малкият допустим брой бъкети >= minCount
+//	void setBucketsCount(size_t count) - вика се при всяко преоразмеряване с число, върнато от roundBucketsCount
+//	size_t index(size_t hash) const - индекс в [0, count)
+
+namespace BucketPolicyConstants
+{
+	constexpr size_t MIN_BUCKETS_COUNT = 8;
+}
+
+//Брой бъкети - степен на двойката. Хешът се разбърква с умножение по 2^64 / φ (Fibonacci hashing)
+//и се взимат най-старшите битове, така че идентитетът std::hash<int> не групира съседни ключове.
+class PowerOfTwoBucketPolicy
+{
+private:
+	unsigned shift = 64 - 3;
+public:
+	static size_t roundBucketsCount(size_t minCount)
+	{
+		size_t count = BucketPolicyConstants::MIN_BUCKETS_COUNT;
+		while (count < minCount)
+			count *= 2;
+		return count;
+	}
+
+	void setBucketsCount(size_t count)
+	{
+		unsigned bits = 0;
+		while ((static_cast<size_t>(1) << bits) < count)
+			bits++;
+		shift = 64 - bits;
+	}
+
+	size_t index(size_t hash) const
+	{
+		return static_cast<size_t>((static_cast<uint64_t>(hash) * 11400714819323198485ull) >> shift);
+	}
+};
+
+//Брой бъкети - просто число. Остатъкът се смята без деление чрез предварително изчислен
+//множител (Lemire, "Faster Remainder by Direct Computation"), след като хешът се свие до 32 бита.
+//Ползата е устойчивост: индексът зависи от всички битове и ключове през степен на двойката не се струпват.
+//Не е по-бърза от деление при топъл кеш (BucketPolicyBenchmark), а за скорост е PowerOfTwoBucketPolicy.
+//Разбъркване преди свиването е пробвано и само забавя, затова свиването е с обикновен XOR.
+class PrimeBucketPolicy
+{
+private:
+	static constexpr uint32_t PRIMES[] = {
+		11u, 23u, 47u, 97u, 193u, 389u, 769u, 1543u, 3079u, 6151u, 12289u, 24593u, 49157u, 98317u,
+		196613u, 393241u, 786433u, 1572869u, 3145739u, 6291469u, 12582917u, 25165843u, 50331653u,
+		100663319u, 201326611u, 402653189u, 805306457u, 1610612741u, 3221225473u, 4294967291u
+	};
+
+	uint32_t divisor = PRIMES[0];
+	uint64_t magic = UINT64_MAX / PRIMES[0] + 1;
+
+	static uint64_t multiplyHigh(uint64_t a, uint64_t b)
+	{
+#if defined(__SIZEOF_INT128__)
+		//__extension__ пази -Wpedantic компилациите без предупреждение за нестандартния тип
+		__extension__ typedef unsigned __int128 uint128;
+		return static_cast<uint64_t>((static_cast<uint128>(a) * b) >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		return __umulh(a, b);
+#else
+		uint64_t aLow = a & 0xFFFFFFFFu, aHigh = a >> 32;
+		uint64_t bLow = b & 0xFFFFFFFFu, bHigh = b >> 32;
+		uint64_t middle = (aLow * bLow >> 32) + (aHigh * bLow & 0xFFFFFFFFu) + aLow * bHigh;
+		return aHigh * bHigh + (aHigh * bLow >> 32) + (middle >> 32);
+#endif
+	}
+public:
+	static size_t roundBucketsCount(size_t minCount)
+	{
+		for (uint32_t prime : PRIMES)
+		{
+			if (prime >= minCount)
+				return prime;
+		}
+		return PRIMES[sizeof(PRIMES) / sizeof(PRIMES[0]) - 1];
+	}
+
+	void setBucketsCount(size_t count)
+	{
+		divisor = static_cast<uint32_t>(count);
+		magic = UINT64_MAX / divisor + 1;
+	}
+
+	size_t index(size_t hash) const
+	{
+		uint64_t wide = hash;
+		uint32_t folded = static_cast<uint32_t>(wide ^ (wide >> 32));
+		return static_cast<size_t>(multiplyHigh(magic * folded, divisor));
+	}
+};
@@ -0,0 +1,168 @@
+﻿#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include "UnorderedSet.hpp"
+
+//Разделя ключовете на независими шардове по най-старшите битове на хеша.
+//Всеки шард е отделен UnorderedSet със собствен reader-writer lock и се преоразмерява сам.
+template<typename Key, typename Hash = std::hash<Key>>
+class ConcurrentUnorderedSet
+{
+private:
+	struct alignas(64) Shard
+	{
+		mutable std::shared_mutex mutex;
+		UnorderedSet<Key, Hash> set;
+	};
+
+	std::unique_ptr<Shard[]> shards;
+	size_t shardsCount;
+	unsigned shardBits;
+	Hash getHash;
+
+	static size_t mixHash(size_t hash);
+	size_t getShardIndex(const Key& key) const;
+public:
+	explicit ConcurrentUnorderedSet(size_t minShardsCount = 64);
+
+	ConcurrentUnorderedSet(const ConcurrentUnorderedSet& other) = delete;
+	ConcurrentUnorderedSet& operator=(const ConcurrentUnorderedSet& other) = delete;
+
+	bool insert(const Key& key);
+	bool remove(const Key& key);
+	bool contains(const Key& key) const;
+
+	template<typename Predicate>
+	size_t erase_if(const Predicate& pred);
+
+	//Шардовете се обхождат един по един, затова промени в други нишки по време на обхождането може да не се видят.
+	template<typename Function>
+	void for_each(const Function& func) const;
+
+	void clear();
+	size_t size() const;
+	bool empty() const;
+	size_t getShardsCount() const;
+};
+
+template<typename Key, typename Hash>
+size_t ConcurrentUnorderedSet<Key, Hash>::mixHash(size_t hash)
+{
+	//финализатор на MurmurHash3 - std::hash<int> е идентитет и старшите му битове са нули
+	uint64_t h = hash;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return static_cast<size_t>(h);
+}
+
+template<typename Key, typename Hash>
+size_t ConcurrentUnorderedSet<Key, Hash>::getShardIndex(const Key& key) const
+{
+	if (shardBits == 0)
+		return 0;
+
+	return mixHash(getHash(key)) >> (sizeof(size_t) * 8 - shardBits);
+}
+
+template<typename Key, typename Hash>
+ConcurrentUnorderedSet<Key, Hash>::ConcurrentUnorderedSet(size_t minShardsCount) : shardsCount(1), shardBits(0)
+{
+	while (shardsCount < minShardsCount)
+	{
+		shardsCount *= 2;
+		shardBits++;
+	}
+	shards = std::make_unique<Shard[]>(shardsCount);
+}
+
+template<typename Key, typename Hash>
+bool ConcurrentUnorderedSet<Key, Hash>::insert(const Key& key)
+{
+	Shard& shard = shards[getShardIndex(key)];
+	std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+	return shard.set.insert(key).second;
+}
+
+template<typename Key, typename Hash>
+bool ConcurrentUnorderedSet<Key, Hash>::remove(const Key& key)
+{
+	Shard& shard = shards[getShardIndex(key)];
+	std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+	size_t oldSize = shard.set.size();
+	shard.set.remove(key);
+	return shard.set.size() != oldSize;
+}
+
+template<typename Key, typename Hash>
+bool ConcurrentUnorderedSet<Key, Hash>::contains(const Key& key) const
+{
+	const Shard& shard = shards[getShardIndex(key)];
+	std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+	return shard.set.contains(key);
+}
+
+template<typename Key, typename Hash>
+template<typename Predicate>
+size_t ConcurrentUnorderedSet<Key, Hash>::erase_if(const Predicate& pred)
+{
+	size_t erasedCount = 0;
+	for (size_t i = 0; i < shardsCount; i++)
+	{
+		std::unique_lock<std::shared_mutex> lock(shards[i].mutex);
+		erasedCount += shards[i].set.erase_if(pred);
+	}
+	return erasedCount;
+}
+
+template<typename Key, typename Hash>
+template<typename Function>
+void ConcurrentUnorderedSet<Key, Hash>::for_each(const Function& func) const
+{
+	for (size_t i = 0; i < shardsCount; i++)
+	{
+		std::shared_lock<std::shared_mutex> lock(shards[i].mutex);
+		shards[i].set.for_each(func);
+	}
+}
+
+template<typename Key, typename Hash>
+void ConcurrentUnorderedSet<Key, Hash>::clear()
+{
+	for (size_t i = 0; i < shardsCount; i++)
+	{
+		std::unique_lock<std::shared_mutex> lock(shards[i].mutex);
+		shards[i].set.clearSet();
+	}
+}
+
+template<typename Key, typename Hash>
+size_t ConcurrentUnorderedSet<Key, Hash>::size() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < shardsCount; i++)
+	{
+		std::shared_lock<std::shared_mutex> lock(shards[i].mutex);
+		count += shards[i].set.size();
+	}
+	return count;
+}
+
+template<typename Key, typename Hash>
+bool ConcurrentUnorderedSet<Key, Hash>::empty() const
+{
+	return size() == 0;
+}
+
+template<typename Key, typename Hash>
+size_t ConcurrentUnorderedSet<Key, Hash>::getShardsCount() const
+{
+	return shardsCount;
+}
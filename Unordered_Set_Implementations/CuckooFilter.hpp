@@ -0,0 +1,316 @@
+﻿#pragma once
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+//Приблизително множество с изтриване (Fan et al., "Cuckoo Filter: Practically Better Than Bloom").
+//За всеки ключ се пази само отпечатък (fingerprint) от 8 или 16 бита в един от два бъкета по 4 слота.
+//Вторият бъкет се смята само от първия и отпечатъка (partial-key cuckoo hashing), затова при изместване
+//не е нужен самият ключ. contains може да върне true за ключ, който не е добавян (вероятност около
+//8 * loadFactor / 2^bits), но никога false за добавен ключ. Слага се пред UnorderedSet, така че
+//повечето търсения на липсващи ключове не стигат до самата таблица:
+//	if (filter.contains(key) && set.contains(key)) ...
+//remove трябва да се вика само за ключове, които са добавени, иначе може да изтрие чужд отпечатък.
+//Повторно добавяне на същия ключ пази още едно копие на отпечатъка (до 8).
+template<typename Key, typename Hash = std::hash<Key>, typename Fingerprint = uint16_t>
+class CuckooFilter
+{
+	static_assert(std::is_same<Fingerprint, uint8_t>::value || std::is_same<Fingerprint, uint16_t>::value,
+		"CuckooFilter fingerprints must be uint8_t or uint16_t");
+private:
+	//Четирите слота на бъкета са една дума, за да се сравняват наведнъж (SWAR)
+	using Word = std::conditional_t<sizeof(Fingerprint) == 1, uint32_t, uint64_t>;
+
+	static constexpr unsigned SLOTS_IN_BUCKET = 4;
+	static constexpr unsigned FINGERPRINT_BITS = sizeof(Fingerprint) * 8;
+	static constexpr Word LOW_BITS = static_cast<Word>(~static_cast<Word>(0)) / static_cast<Fingerprint>(~static_cast<Fingerprint>(0)); //0x0101... или 0x00010001...
+	static constexpr Word HIGH_BITS = LOW_BITS << (FINGERPRINT_BITS - 1);
+	static constexpr unsigned MAX_KICKS = 500;
+	static constexpr double MAX_LOAD_FACTOR = 0.95;
+
+	std::vector<Word> buckets; //размерът е степен на двойката, 0 е празен слот
+	size_t bucketsMask = 0;
+	size_t elementsCount = 0;
+
+	//Отпечатък, който не е намерил място след MAX_KICKS измествания. Докато го има, insert връща false.
+	bool hasVictim = false;
+	Fingerprint victimFingerprint = 0;
+	size_t victimIndex = 0;
+
+	uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+	Hash getHash;
+
+	static uint64_t mix(uint64_t h);
+	void hashKey(const Key& key, size_t& index, Fingerprint& fingerprint) const;
+	size_t alternateIndex(size_t index, Fingerprint fingerprint) const;
+
+	static Fingerprint getSlot(Word bucket, unsigned slot);
+	static Word setSlot(Word bucket, unsigned slot, Fingerprint fingerprint);
+	static Word zeroSlots(Word bucket); //вдига старшия бит на най-ниския нулев слот (и може би на някои след него)
+	static int findInBucket(Word bucket, Fingerprint fingerprint); //индекс на слот или -1
+
+	bool tryStore(size_t index, Fingerprint fingerprint);
+	bool removeFromBucket(size_t index, Fingerprint fingerprint);
+
+	//Слага отпечатъка в index или в другия му бъкет, като при нужда измества други.
+	//Ако след MAX_KICKS измествания някой остане без място, той става victim.
+	void place(size_t index, Fingerprint fingerprint);
+	unsigned nextRandom();
+public:
+	//Таблицата се оразмерява веднъж - за около expectedElements ключа при натоварване до 95%
+	explicit CuckooFilter(size_t expectedElements = 1024);
+
+	//false, ако филтърът е пълен - тогава ключът не е добавен
+	bool insert(const Key& key);
+	bool contains(const Key& key) const;
+	bool remove(const Key& key);
+
+	void clear();
+
+	size_t size() const;
+	bool empty() const;
+	size_t capacity() const; //брой слотове
+	double loadFactor() const;
+
+	//Очакваната вероятност за false positive при текущото натоварване: 1 - (1 - 2^-bits)^(2 * 4 * loadFactor)
+	double estimatedFalsePositiveRate() const;
+
+	size_t memory_usage() const;
+};
+
+template<typename Key, typename Hash, typename Fingerprint>
+uint64_t CuckooFilter<Key, Hash, Fingerprint>::mix(uint64_t h)
+{
+	//финализатор на MurmurHash3 - std::hash<int> е идентитет
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+void CuckooFilter<Key, Hash, Fingerprint>::hashKey(const Key& key, size_t& index, Fingerprint& fingerprint) const
+{
+	uint64_t h = mix(getHash(key));
+	index = static_cast<size_t>(h) & bucketsMask;
+	fingerprint = static_cast<Fingerprint>(h >> (64 - FINGERPRINT_BITS));
+	if (fingerprint == 0)
+		fingerprint = 1;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+size_t CuckooFilter<Key, Hash, Fingerprint>::alternateIndex(size_t index, Fingerprint fingerprint) const
+{
+	//xor прави връзката симетрична: alternateIndex(alternateIndex(i, f), f) == i
+	return (index ^ static_cast<size_t>(fingerprint * 0x5bd1e995ULL)) & bucketsMask;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+Fingerprint CuckooFilter<Key, Hash, Fingerprint>::getSlot(Word bucket, unsigned slot)
+{
+	return static_cast<Fingerprint>(bucket >> (slot * FINGERPRINT_BITS));
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+typename CuckooFilter<Key, Hash, Fingerprint>::Word CuckooFilter<Key, Hash, Fingerprint>::setSlot(Word bucket, unsigned slot, Fingerprint fingerprint)
+{
+	unsigned shift = slot * FINGERPRINT_BITS;
+	Word mask = static_cast<Word>(static_cast<Fingerprint>(~static_cast<Fingerprint>(0))) << shift;
+	return (bucket & ~mask) | (static_cast<Word>(fingerprint) << shift);
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+typename CuckooFilter<Key, Hash, Fingerprint>::Word CuckooFilter<Key, Hash, Fingerprint>::zeroSlots(Word bucket)
+{
+	//"has zero byte" трикът: пренос може да вдигне бит и над истински нулев слот, но най-ниският вдигнат е точен
+	return (bucket - LOW_BITS) & ~bucket & HIGH_BITS;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+int CuckooFilter<Key, Hash, Fingerprint>::findInBucket(Word bucket, Fingerprint fingerprint)
+{
+	Word matches = zeroSlots(bucket ^ (LOW_BITS * fingerprint));
+	if (matches == 0)
+		return -1;
+
+	unsigned slot = 0;
+	while (!(matches & (static_cast<Word>(1) << (slot * FINGERPRINT_BITS + FINGERPRINT_BITS - 1))))
+		slot++;
+	return static_cast<int>(slot);
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+bool CuckooFilter<Key, Hash, Fingerprint>::tryStore(size_t index, Fingerprint fingerprint)
+{
+	int slot = findInBucket(buckets[index], 0);
+	if (slot < 0)
+		return false;
+
+	buckets[index] = setSlot(buckets[index], static_cast<unsigned>(slot), fingerprint);
+	return true;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+bool CuckooFilter<Key, Hash, Fingerprint>::removeFromBucket(size_t index, Fingerprint fingerprint)
+{
+	int slot = findInBucket(buckets[index], fingerprint);
+	if (slot < 0)
+		return false;
+
+	buckets[index] = setSlot(buckets[index], static_cast<unsigned>(slot), 0);
+	return true;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+void CuckooFilter<Key, Hash, Fingerprint>::place(size_t index, Fingerprint fingerprint)
+{
+	size_t other = alternateIndex(index, fingerprint);
+	if (tryStore(index, fingerprint) || tryStore(other, fingerprint))
+		return;
+
+	//отпечатъкът заема случаен слот, а изгоненият отива в своя друг бъкет
+	index = (nextRandom() & 1) ? index : other;
+	for (unsigned kick = 0; kick < MAX_KICKS; kick++)
+	{
+		unsigned slot = nextRandom() % SLOTS_IN_BUCKET;
+		Fingerprint evicted = getSlot(buckets[index], slot);
+		buckets[index] = setSlot(buckets[index], slot, fingerprint);
+		fingerprint = evicted;
+
+		index = alternateIndex(index, fingerprint);
+		if (tryStore(index, fingerprint))
+			return;
+	}
+
+	hasVictim = true;
+	victimFingerprint = fingerprint;
+	victimIndex = index;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+unsigned CuckooFilter<Key, Hash, Fingerprint>::nextRandom()
+{
+	//xorshift64 - достатъчен за избор на слот за изместване
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+	return static_cast<unsigned>(randomState >> 32);
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+CuckooFilter<Key, Hash, Fingerprint>::CuckooFilter(size_t expectedElements)
+{
+	size_t bucketsCount = 1;
+	while (bucketsCount * SLOTS_IN_BUCKET * MAX_LOAD_FACTOR < expectedElements)
+		bucketsCount *= 2;
+
+	buckets.assign(bucketsCount, 0);
+	bucketsMask = bucketsCount - 1;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+bool CuckooFilter<Key, Hash, Fingerprint>::insert(const Key& key)
+{
+	if (hasVictim)
+		return false;
+
+	size_t index;
+	Fingerprint fingerprint;
+	hashKey(key, index, fingerprint);
+
+	place(index, fingerprint);
+	elementsCount++;
+	return true;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+bool CuckooFilter<Key, Hash, Fingerprint>::contains(const Key& key) const
+{
+	size_t index;
+	Fingerprint fingerprint;
+	hashKey(key, index, fingerprint);
+
+	size_t other = alternateIndex(index, fingerprint);
+	if (hasVictim && victimFingerprint == fingerprint && (victimIndex == index || victimIndex == other))
+		return true;
+
+	return findInBucket(buckets[index], fingerprint) >= 0 || findInBucket(buckets[other], fingerprint) >= 0;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+bool CuckooFilter<Key, Hash, Fingerprint>::remove(const Key& key)
+{
+	size_t index;
+	Fingerprint fingerprint;
+	hashKey(key, index, fingerprint);
+
+	size_t other = alternateIndex(index, fingerprint);
+	if (hasVictim && victimFingerprint == fingerprint && (victimIndex == index || victimIndex == other))
+	{
+		hasVictim = false;
+		elementsCount--;
+		return true;
+	}
+
+	if (!removeFromBucket(index, fingerprint) && !removeFromBucket(other, fingerprint))
+		return false;
+
+	elementsCount--;
+
+	//освободи се слот - отложеният отпечатък може да си намери място
+	if (hasVictim)
+	{
+		hasVictim = false;
+		place(victimIndex, victimFingerprint);
+	}
+	return true;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+void CuckooFilter<Key, Hash, Fingerprint>::clear()
+{
+	buckets.assign(buckets.size(), 0);
+	elementsCount = 0;
+	hasVictim = false;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+size_t CuckooFilter<Key, Hash, Fingerprint>::size() const
+{
+	return elementsCount;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+bool CuckooFilter<Key, Hash, Fingerprint>::empty() const
+{
+	return elementsCount == 0;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+size_t CuckooFilter<Key, Hash, Fingerprint>::capacity() const
+{
+	return buckets.size() * SLOTS_IN_BUCKET;
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+double CuckooFilter<Key, Hash, Fingerprint>::loadFactor() const
+{
+	return static_cast<double>(elementsCount) / capacity();
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+double CuckooFilter<Key, Hash, Fingerprint>::estimatedFalsePositiveRate() const
+{
+	double missOneSlot = 1.0 - 1.0 / ((1u << FINGERPRINT_BITS) - 1);
+	return 1.0 - std::pow(missOneSlot, 2.0 * SLOTS_IN_BUCKET * loadFactor());
+}
+
+template<typename Key, typename Hash, typename Fingerprint>
+size_t CuckooFilter<Key, Hash, Fingerprint>::memory_usage() const
+{
+	return sizeof(*this) + buckets.capacity() * sizeof(Word);
+}
@@ -0,0 +1,471 @@
+﻿#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "UnorderedSet.hpp"
+#include "../Boolean_Vector_Implementation/BooleanVector.hpp"
+
+//Automatic - битова карта, докато ключовете са достатъчно гъсти, иначе хеширане
+//Bitmap - винаги битова карта (ключ извън MAX_BITMAP_RANGE хвърля out_of_range)
+//Hashed - винаги UnorderedSet
+enum class DenseIntegerSetMode
+{
+	Automatic,
+	Bitmap,
+	Hashed
+};
+
+//Множество от цели числа с две представяния. При гъсти ключове (напр. id-та в [0, 2^28))
+//се пази BooleanVector, в който битът i отговаря на ключа base + i - 1 бит на възможен ключ вместо възел от ~32 байта.
+//Когато ключовете станат редки спрямо обхвата си, данните се прехвърлят в UnorderedSet и обратно.
+//Праговете за двете посоки са различни, за да не се превключва при всяко добавяне/изтриване около границата.
+template<typename Key, typename Hash = std::hash<Key>>
+class DenseIntegerSet
+{
+	static_assert(std::is_integral<Key>::value, "DenseIntegerSet keys must be integers");
+private:
+	static constexpr uint64_t MAX_BITMAP_RANGE = static_cast<uint64_t>(1) << 28; //32MB битова карта
+	static constexpr uint64_t MIN_BITMAP_RANGE = 64;
+	static constexpr uint64_t MAX_BITS_PER_KEY_TO_DENSIFY = 256; //32 байта на ключ - колкото струва възел в UnorderedSet
+	static constexpr uint64_t MAX_BITS_PER_KEY_TO_STAY_DENSE = 1024;
+
+	DenseIntegerSetMode mode;
+	bool dense = false;
+
+	BooleanVector<> bitmap;
+	Key base = 0; //ключът на бит 0
+	size_t bitmapCount = 0;
+
+	UnorderedSet<Key, Hash> hashed;
+	Key minKey = 0, maxKey = 0; //обхватът на ключовете, добавени в hashed (само се разширява)
+
+	static uint64_t distance(Key from, Key to); //to - from без препълване, при from <= to
+	static Key advance(Key from, uint64_t offset);
+	Key keyAt(size_t bitIndex) const;
+	bool inBitmap(const Key& key, size_t& bitIndex) const;
+	bool shouldDensify() const;
+
+	void toBitmap(Key newBase, uint64_t range);
+	void toHashed();
+	void growBitmapOrFallBack(const Key& key); //за ключ извън картата
+public:
+	class ConstIterator
+	{
+	private:
+		const DenseIntegerSet<Key, Hash>* set;
+		size_t bitIndex; //== bitmap.size() за cend() в режим битова карта
+		typename UnorderedSet<Key, Hash>::ConstIterator hashedIter;
+		Key current;
+
+		ConstIterator(const DenseIntegerSet<Key, Hash>* _set, size_t _bitIndex, typename UnorderedSet<Key, Hash>::ConstIterator _hashedIter);
+		friend class DenseIntegerSet;
+	public:
+		const Key& operator*() const;
+		const Key* operator->() const;
+
+		ConstIterator& operator++(); //++it
+		ConstIterator operator++(int); //it++
+
+		bool operator==(const ConstIterator& rhs) const;
+		bool operator!=(const ConstIterator& rhs) const;
+	};
+
+	explicit DenseIntegerSet(DenseIntegerSetMode mode = DenseIntegerSetMode::Automatic);
+
+	//Битова карта за ключовете [minKey, maxKey] още от началото
+	DenseIntegerSet(Key minKey, Key maxKey, DenseIntegerSetMode mode = DenseIntegerSetMode::Automatic);
+
+	std::pair<ConstIterator, bool> insert(const Key& key);
+	void remove(const Key& key);
+
+	ConstIterator find(const Key& key) const;
+	bool contains(const Key& key) const;
+	size_t count(const Key& key) const;
+
+	//При битова карта ключовете се обхождат във възходящ ред
+	template<typename Function>
+	void for_each(const Function& func) const;
+
+	ConstIterator begin() const;
+	ConstIterator end() const;
+	ConstIterator cbegin() const;
+	ConstIterator cend() const;
+
+	void clearSet();
+	bool empty() const;
+	size_t size() const;
+
+	bool isBitmap() const;
+	DenseIntegerSetMode getMode() const;
+
+	//Байтове, заявени от алокатора (приблизително за битовата карта)
+	size_t memory_usage() const;
+};
+
+template<typename Key, typename Hash>
+uint64_t DenseIntegerSet<Key, Hash>::distance(Key from, Key to)
+{
+	//разликата по модул 2^64 е вярна и за знакови типове
+	return static_cast<uint64_t>(to) - static_cast<uint64_t>(from);
+}
+
+template<typename Key, typename Hash>
+Key DenseIntegerSet<Key, Hash>::advance(Key from, uint64_t offset)
+{
+	return static_cast<Key>(static_cast<uint64_t>(from) + offset);
+}
+
+template<typename Key, typename Hash>
+Key DenseIntegerSet<Key, Hash>::keyAt(size_t bitIndex) const
+{
+	return advance(base, bitIndex);
+}
+
+template<typename Key, typename Hash>
+bool DenseIntegerSet<Key, Hash>::inBitmap(const Key& key, size_t& bitIndex) const
+{
+	if (key < base)
+		return false;
+
+	uint64_t offset = distance(base, key);
+	if (offset >= bitmap.size())
+		return false;
+
+	bitIndex = static_cast<size_t>(offset);
+	return true;
+}
+
+template<typename Key, typename Hash>
+bool DenseIntegerSet<Key, Hash>::shouldDensify() const
+{
+	if (mode != DenseIntegerSetMode::Automatic || hashed.empty())
+		return false;
+
+	uint64_t range = distance(minKey, maxKey);
+	return range < MAX_BITMAP_RANGE && range + 1 <= MAX_BITS_PER_KEY_TO_DENSIFY * hashed.size();
+}
+
+template<typename Key, typename Hash>
+void DenseIntegerSet<Key, Hash>::toBitmap(Key newBase, uint64_t range)
+{
+	BooleanVector<> newBitmap(static_cast<size_t>(range), false);
+	auto setBit = [&newBitmap, newBase](const Key& key) { newBitmap.set(static_cast<size_t>(distance(newBase, key)), true); };
+
+	if (dense)
+	{
+		for (size_t i = bitmap.find_next(0); i < bitmap.size(); i = bitmap.find_next(i + 1))
+			setBit(keyAt(i));
+	}
+	else
+	{
+		hashed.for_each(setBit);
+		bitmapCount = hashed.size();
+		hashed.clearSet();
+	}
+
+	bitmap = std::move(newBitmap);
+	base = newBase;
+	dense = true;
+}
+
+template<typename Key, typename Hash>
+void DenseIntegerSet<Key, Hash>::toHashed()
+{
+	hashed.clearSet();
+	hashed.reserve(bitmapCount);
+	bool first = true;
+	for (size_t i = bitmap.find_next(0); i < bitmap.size(); i = bitmap.find_next(i + 1))
+	{
+		Key key = keyAt(i);
+		hashed.insert(key);
+		if (first || key < minKey)
+			minKey = key;
+		if (first || key > maxKey)
+			maxKey = key;
+		first = false;
+	}
+
+	bitmap = BooleanVector<>();
+	bitmapCount = 0;
+	dense = false;
+}
+
+template<typename Key, typename Hash>
+void DenseIntegerSet<Key, Hash>::growBitmapOrFallBack(const Key& key)
+{
+	Key first = key < base ? key : base;
+	Key last = key > keyAt(bitmap.size() - 1) ? key : keyAt(bitmap.size() - 1);
+	uint64_t range = distance(first, last) + 1;
+	bool fits = range != 0 && range <= MAX_BITMAP_RANGE;
+	if (mode == DenseIntegerSetMode::Bitmap && !fits)
+		throw std::out_of_range("Key is outside the bitmap range");
+
+	if (!fits || (mode == DenseIntegerSetMode::Automatic && range > MAX_BITS_PER_KEY_TO_STAY_DENSE * (bitmapCount + 1)))
+	{
+		toHashed();
+		return;
+	}
+
+	//картата расте поне двойно в посоката на новия ключ, за да не се копира при всеки следващ
+	uint64_t extra = std::min(static_cast<uint64_t>(bitmap.size()), MAX_BITMAP_RANGE - range);
+	if (key < base)
+		first = advance(first, 0 - std::min(extra, distance(std::numeric_limits<Key>::min(), first)));
+	else
+		last = advance(last, std::min(extra, distance(last, std::numeric_limits<Key>::max())));
+
+	toBitmap(first, distance(first, last) + 1);
+}
+
+template<typename Key, typename Hash>
+DenseIntegerSet<Key, Hash>::ConstIterator::ConstIterator(const DenseIntegerSet<Key, Hash>* _set, size_t _bitIndex, typename UnorderedSet<Key, Hash>::ConstIterator _hashedIter)
+	: set(_set), bitIndex(_bitIndex), hashedIter(_hashedIter), current(0)
+{
+	if (set->dense && bitIndex < set->bitmap.size())
+		current = set->keyAt(bitIndex);
+}
+
+template<typename Key, typename Hash>
+const Key& DenseIntegerSet<Key, Hash>::ConstIterator::operator*() const
+{
+	return set->dense ? current : *hashedIter;
+}
+
+template<typename Key, typename Hash>
+const Key* DenseIntegerSet<Key, Hash>::ConstIterator::operator->() const
+{
+	return &(**this);
+}
+
+template<typename Key, typename Hash>
+typename DenseIntegerSet<Key, Hash>::ConstIterator& DenseIntegerSet<Key, Hash>::ConstIterator::operator++()
+{
+	if (set->dense)
+	{
+		bitIndex = set->bitmap.find_next(bitIndex + 1);
+		if (bitIndex < set->bitmap.size())
+			current = set->keyAt(bitIndex);
+	}
+	else
+		++hashedIter;
+	return *this;
+}
+
+template<typename Key, typename Hash>
+typename DenseIntegerSet<Key, Hash>::ConstIterator DenseIntegerSet<Key, Hash>::ConstIterator::operator++(int)
+{
+	ConstIterator copy(*this);
+	++(*this);
+	return copy;
+}
+
+template<typename Key, typename Hash>
+bool DenseIntegerSet<Key, Hash>::ConstIterator::operator==(const ConstIterator& rhs) const
+{
+	return set->dense ? bitIndex == rhs.bitIndex : hashedIter == rhs.hashedIter;
+}
+
+template<typename Key, typename Hash>
+bool DenseIntegerSet<Key, Hash>::ConstIterator::operator!=(const ConstIterator& rhs) const
+{
+	return !(*this == rhs);
+}
+
+template<typename Key, typename Hash>
+DenseIntegerSet<Key, Hash>::DenseIntegerSet(DenseIntegerSetMode mode) : mode(mode)
+{
+	if (mode == DenseIntegerSetMode::Bitmap)
+		toBitmap(0, MIN_BITMAP_RANGE);
+}
+
+template<typename Key, typename Hash>
+DenseIntegerSet<Key, Hash>::DenseIntegerSet(Key minKey, Key maxKey, DenseIntegerSetMode mode) : mode(mode)
+{
+	if (maxKey < minKey)
+		throw std::invalid_argument("maxKey must not be less than minKey");
+
+	uint64_t range = distance(minKey, maxKey) + 1;
+	if (range == 0 || range > MAX_BITMAP_RANGE)
+		throw std::out_of_range("Key range is too large for a bitmap");
+
+	if (mode != DenseIntegerSetMode::Hashed)
+		toBitmap(minKey, range);
+}
+
+template<typename Key, typename Hash>
+std::pair<typename DenseIntegerSet<Key, Hash>::ConstIterator, bool> DenseIntegerSet<Key, Hash>::insert(const Key& key)
+{
+	size_t bitIndex;
+	if (dense && !inBitmap(key, bitIndex))
+	{
+		growBitmapOrFallBack(key);
+		if (dense)
+			inBitmap(key, bitIndex);
+	}
+
+	if (dense)
+	{
+		bool inserted = !bitmap[bitIndex];
+		if (inserted)
+		{
+			bitmap.set(bitIndex, true);
+			bitmapCount++;
+		}
+		return { ConstIterator(this, bitIndex, hashed.cend()), inserted };
+	}
+
+	bool wasEmpty = hashed.empty();
+	bool inserted = hashed.insert(key).second;
+	if (inserted)
+	{
+		if (wasEmpty || key < minKey)
+			minKey = key;
+		if (wasEmpty || key > maxKey)
+			maxKey = key;
+
+		if (shouldDensify())
+		{
+			uint64_t range = std::max(distance(minKey, maxKey) + 1, MIN_BITMAP_RANGE);
+			uint64_t room = distance(minKey, std::numeric_limits<Key>::max()) + 1;
+			if (room != 0)
+				range = std::min(range, room);
+			toBitmap(minKey, range);
+		}
+	}
+	return { find(key), inserted };
+}
+
+template<typename Key, typename Hash>
+void DenseIntegerSet<Key, Hash>::remove(const Key& key)
+{
+	if (!dense)
+	{
+		hashed.remove(key);
+		return;
+	}
+
+	size_t bitIndex;
+	if (!inBitmap(key, bitIndex) || !bitmap[bitIndex])
+		return;
+
+	bitmap.set(bitIndex, false);
+	bitmapCount--;
+
+	if (mode == DenseIntegerSetMode::Automatic && bitmap.size() > MIN_BITMAP_RANGE
+		&& bitmap.size() > MAX_BITS_PER_KEY_TO_STAY_DENSE * bitmapCount)
+		toHashed();
+}
+
+template<typename Key, typename Hash>
+typename DenseIntegerSet<Key, Hash>::ConstIterator DenseIntegerSet<Key, Hash>::find(const Key& key) const
+{
+	if (!dense)
+		return ConstIterator(this, 0, hashed.find(key));
+
+	size_t bitIndex;
+	if (inBitmap(key, bitIndex) && bitmap[bitIndex])
+		return ConstIterator(this, bitIndex, hashed.cend());
+	return cend();
+}
+
+template<typename Key, typename Hash>
+bool DenseIntegerSet<Key, Hash>::contains(const Key& key) const
+{
+	if (!dense)
+		return hashed.contains(key);
+
+	size_t bitIndex;
+	return inBitmap(key, bitIndex) && bitmap[bitIndex];
+}
+
+template<typename Key, typename Hash>
+size_t DenseIntegerSet<Key, Hash>::count(const Key& key) const
+{
+	return contains(key) ? 1 : 0;
+}
+
+template<typename Key, typename Hash>
+template<typename Function>
+void DenseIntegerSet<Key, Hash>::for_each(const Function& func) const
+{
+	if (!dense)
+	{
+		hashed.for_each(func);
+		return;
+	}
+
+	for (size_t i = bitmap.find_next(0); i < bitmap.size(); i = bitmap.find_next(i + 1))
+	{
+		Key key = keyAt(i);
+		func(key);
+	}
+}
+
+template<typename Key, typename Hash>
+typename DenseIntegerSet<Key, Hash>::ConstIterator DenseIntegerSet<Key, Hash>::begin() const
+{
+	return cbegin();
+}
+
+template<typename Key, typename Hash>
+typename DenseIntegerSet<Key, Hash>::ConstIterator DenseIntegerSet<Key, Hash>::end() const
+{
+	return cend();
+}
+
+template<typename Key, typename Hash>
+typename DenseIntegerSet<Key, Hash>::ConstIterator DenseIntegerSet<Key, Hash>::cbegin() const
+{
+	if (dense)
+		return ConstIterator(this, bitmap.find_next(0), hashed.cend());
+	return ConstIterator(this, 0, hashed.cbegin());
+}
+
+template<typename Key, typename Hash>
+typename DenseIntegerSet<Key, Hash>::ConstIterator DenseIntegerSet<Key, Hash>::cend() const
+{
+	return ConstIterator(this, dense ? bitmap.size() : 0, hashed.cend());
+}
+
+template<typename Key, typename Hash>
+void DenseIntegerSet<Key, Hash>::clearSet()
+{
+	hashed.clearSet();
+	bitmap = BooleanVector<>();
+	bitmapCount = 0;
+	dense = false;
+	if (mode == DenseIntegerSetMode::Bitmap)
+		toBitmap(0, MIN_BITMAP_RANGE);
+}
+
+template<typename Key, typename Hash>
+bool DenseIntegerSet<Key, Hash>::empty() const
+{
+	return size() == 0;
+}
+
+template<typename Key, typename Hash>
+size_t DenseIntegerSet<Key, Hash>::size() const
+{
+	return dense ? bitmapCount : hashed.size();
+}
+
+template<typename Key, typename Hash>
+bool DenseIntegerSet<Key, Hash>::isBitmap() const
+{
+	return dense;
+}
+
+template<typename Key, typename Hash>
+DenseIntegerSetMode DenseIntegerSet<Key, Hash>::getMode() const
+{
+	return mode;
+}
+
+template<typename Key, typename Hash>
+size_t DenseIntegerSet<Key, Hash>::memory_usage() const
+{
+	return sizeof(*this) - sizeof(hashed) + hashed.memory_usage() + bitmap.capacity() / 8;
+}
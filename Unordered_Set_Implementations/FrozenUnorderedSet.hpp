@@ -0,0 +1,681 @@
+﻿#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "UnorderedSet.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Хеш, който не зависи от std::hash и от процеса - замразеното множество може да се запише във файл
+//и да се чете от друга програма. Думите се четат в реда на байтовете на машината, който се пази в заглавието.
+namespace FrozenHashing
+{
+	inline uint64_t mix(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	inline uint64_t hashBytes(const void* data, size_t length, uint64_t seed)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		uint64_t h = seed ^ (length * 0x9E3779B97F4A7C15ULL);
+		while (length >= 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, bytes, 8);
+			h = (h ^ mix(word)) * 0x9E3779B97F4A7C15ULL;
+			bytes += 8;
+			length -= 8;
+		}
+
+		uint64_t tail = 0;
+		std::memcpy(&tail, bytes, length);
+		return mix(h ^ tail);
+	}
+
+	//Равномерно число в [0, range) от старшите 32 бита на h, без деление
+	inline uint32_t reduce(uint64_t h, uint32_t range)
+	{
+		return static_cast<uint32_t>(((h >> 32) * range) >> 32);
+	}
+}
+
+//Как ключът се пази в буфера. Ключове без вътрешни указатели и padding се копират побайтово,
+//а низовете се пазят в общ пул и слотът съдържа отместване, дължина и част от хеша.
+template<typename Key, typename = void>
+struct FrozenKeyCodec
+{
+	static_assert(sizeof(Key) == 0, "FrozenUnorderedSet supports std::string and trivially copyable keys without padding");
+};
+
+template<typename Key>
+struct FrozenKeyCodec<Key, std::enable_if_t<std::is_trivially_copyable<Key>::value && std::has_unique_object_representations<Key>::value>>
+{
+	static constexpr uint32_t KIND = 0;
+	using Slot = Key;
+	using LookupKey = Key;
+
+	static uint64_t hash(const Key& key, uint64_t seed) { return FrozenHashing::hashBytes(&key, sizeof(Key), seed); }
+	static size_t poolBytes(const Key&) { return 0; }
+
+	static Slot makeSlot(const Key& key, uint64_t, char*, size_t&) { return key; }
+	static bool fitsPool(const Slot&, size_t) { return true; }
+	static bool matches(const Slot& slot, const Key& key, uint64_t, const char*) { return std::memcmp(&slot, &key, sizeof(Key)) == 0; }
+	static const Key& view(const Slot& slot, const char*) { return slot; }
+};
+
+struct FrozenStringSlot
+{
+	uint64_t offset;
+	uint32_t length;
+	uint32_t hashTag; //младшите 32 бита на хеша - повечето разминавания се отхвърлят без достъп до пула
+};
+
+template<>
+struct FrozenKeyCodec<std::string>
+{
+	static constexpr uint32_t KIND = 1;
+	using Slot = FrozenStringSlot;
+	using LookupKey = std::string_view;
+
+	static uint64_t hash(std::string_view key, uint64_t seed) { return FrozenHashing::hashBytes(key.data(), key.size(), seed); }
+	static size_t poolBytes(const std::string& key) { return key.size(); }
+
+	static Slot makeSlot(const std::string& key, uint64_t hash, char* pool, size_t& poolUsed)
+	{
+		Slot slot{ poolUsed, static_cast<uint32_t>(key.size()), static_cast<uint32_t>(hash) };
+		std::memcpy(pool + poolUsed, key.data(), key.size());
+		poolUsed += key.size();
+		return slot;
+	}
+
+	static bool fitsPool(const Slot& slot, size_t poolSize)
+	{
+		return slot.offset <= poolSize && slot.length <= poolSize - slot.offset;
+	}
+
+	static bool matches(const Slot& slot, std::string_view key, uint64_t hash, const char* pool)
+	{
+		return slot.hashTag == static_cast<uint32_t>(hash) && slot.length == key.size()
+			&& std::memcmp(pool + slot.offset, key.data(), key.size()) == 0;
+	}
+
+	static std::string_view view(const Slot& slot, const char* pool) { return std::string_view(pool + slot.offset, slot.length); }
+};
+
+//Файл, картиран само за четене. Всички процеси, които картират един файл, делят едни и същи физически страници.
+class ReadOnlyFileMapping
+{
+private:
+	const char* data = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+
+	void release()
+	{
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+		mapping = nullptr;
+#else
+		if (data)
+			munmap(const_cast<char*>(data), length);
+#endif
+		data = nullptr;
+		length = 0;
+	}
+public:
+	ReadOnlyFileMapping() = default;
+
+	explicit ReadOnlyFileMapping(const std::string& path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Cannot open " + path);
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			release();
+			throw std::runtime_error("Cannot map empty file " + path);
+		}
+		length = static_cast<size_t>(fileSize.QuadPart);
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		data = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+		if (!data)
+		{
+			release();
+			throw std::runtime_error("Cannot map " + path);
+		}
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error("Cannot open " + path);
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			close(fd);
+			throw std::runtime_error("Cannot map empty file " + path);
+		}
+
+		void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd); //картирането остава валидно и след затварянето на файла
+		if (mapped == MAP_FAILED)
+			throw std::runtime_error("Cannot map " + path);
+
+		data = static_cast<const char*>(mapped);
+		length = static_cast<size_t>(info.st_size);
+#endif
+	}
+
+	ReadOnlyFileMapping(ReadOnlyFileMapping&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	ReadOnlyFileMapping& operator=(ReadOnlyFileMapping&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			std::swap(data, other.data);
+			std::swap(length, other.length);
+#ifdef _WIN32
+			std::swap(file, other.file);
+			std::swap(mapping, other.mapping);
+#endif
+		}
+		return *this;
+	}
+
+	ReadOnlyFileMapping(const ReadOnlyFileMapping& other) = delete;
+	ReadOnlyFileMapping& operator=(const ReadOnlyFileMapping& other) = delete;
+
+	~ReadOnlyFileMapping()
+	{
+		release();
+	}
+
+	const char* getData() const { return data; }
+	size_t size() const { return length; }
+};
+
+//Неизменимо множество с минимален перфектен хеш (CHD - hash, displace and compress).
+//Ключовете се разпределят в n / 4 групи и за всяка група се намира отместване, при което ключовете ѝ
+//попадат в различни свободни позиции измежду m = n + n / 64 + 1. Без излишъка последните групи търсят
+//единствения свободен слот с около n опита и при големи n построяването не завършва.
+//Ключовете на позиции p >= n се преместват в празните слотове под n чрез таблица remap с m - n елемента,
+//така че слотовете са точно n и index_of остава в [0, n).
+//Търсене: хеш на ключа, едно четене на отместването и едно на слота (плюс remap за около 1.5% от ключовете и пула при низовете).
+//Целият обект е един непрекъснат буфер без указатели, който се записва във файл и се картира обратно без десериализация.
+template<typename Key>
+class FrozenUnorderedSet
+{
+private:
+	using Codec = FrozenKeyCodec<Key>;
+	using Slot = typename Codec::Slot;
+	using LookupKey = typename Codec::LookupKey;
+
+	static_assert(alignof(Slot) <= 8, "FrozenUnorderedSet keys must not need more than 8-byte alignment");
+
+	static constexpr char MAGIC[8] = { 'F', 'R', 'Z', 'N', 'S', 'E', 'T', '2' };
+	static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+	static constexpr uint64_t DISPLACEMENT_STEP = 0x9E3779B97F4A7C15ULL;
+	static constexpr uint32_t MAX_DISPLACEMENT = 1u << 24; //след толкова опита групата се смята за неразрешима и се сменя seed-ът
+	static constexpr size_t KEYS_PER_GROUP = 4;
+	static constexpr uint32_t EXTRA_POSITIONS_DIVISOR = 64; //m = n + n / 64 + 1, т.е. натоварване около 0.985
+	static constexpr unsigned MAX_SEED_ATTEMPTS = 32; //с излишъка почти винаги стига първият seed
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t byteOrder;
+		uint32_t keyKind;
+		uint64_t slotSize;
+		uint64_t seed;
+		uint64_t keysCount;
+		uint64_t groupsCount;
+		uint64_t positionsCount;
+		uint64_t displacementsOffset;
+		uint64_t remapOffset;
+		uint64_t slotsOffset;
+		uint64_t poolOffset;
+		uint64_t totalSize;
+	};
+
+	std::vector<uint64_t> ownedBuffer; //uint64_t, за да е подравнен буферът
+	ReadOnlyFileMapping mapping;
+
+	const char* buffer = nullptr;
+	size_t bufferSize = 0;
+	uint64_t seed = 0;
+	uint32_t keysCount = 0;
+	uint32_t groupsCount = 0;
+	uint32_t positionsCount = 0;
+	const uint32_t* displacements = nullptr;
+	const uint32_t* remap = nullptr;
+	const Slot* slots = nullptr;
+	const char* pool = nullptr;
+
+	FrozenUnorderedSet() = default;
+
+	static size_t alignUp(size_t offset) { return (offset + 7) & ~static_cast<size_t>(7); }
+
+	static uint32_t positionFor(uint64_t hash, uint32_t displacement, uint32_t positionsCount)
+	{
+		return FrozenHashing::reduce(FrozenHashing::mix(hash + displacement * DISPLACEMENT_STEP), positionsCount);
+	}
+
+	static uint32_t groupFor(uint64_t hash, uint32_t groupsCount)
+	{
+		return FrozenHashing::reduce(hash, groupsCount);
+	}
+
+	static bool rangeFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t end)
+	{
+		return offset % 8 == 0 && offset <= end && count <= (end - offset) / elementSize;
+	}
+
+	//Проверява заглавието, таблиците и слотовете и насочва указателите към буфера.
+	//Слотовете се обхождат веднъж, за да не може повреден файл да доведе до четене извън него.
+	void attach(const char* data, size_t size);
+	void detach();
+
+	static FrozenUnorderedSet build(const std::vector<const Key*>& keys);
+
+	template<typename K, typename H, typename E, typename P>
+	friend FrozenUnorderedSet<K> freeze(const UnorderedSet<K, H, E, P>& set);
+public:
+	static constexpr size_t NPOS = static_cast<size_t>(-1);
+
+	FrozenUnorderedSet(FrozenUnorderedSet&& other) noexcept;
+	FrozenUnorderedSet& operator=(FrozenUnorderedSet&& other) noexcept;
+
+	FrozenUnorderedSet(const FrozenUnorderedSet& other) = delete;
+	FrozenUnorderedSet& operator=(const FrozenUnorderedSet& other) = delete;
+
+	//Картира файл, записан с writeToFile. Хвърля runtime_error, ако файлът не е валиден за този тип ключ.
+	static FrozenUnorderedSet mapFile(const std::string& path);
+	void writeToFile(const std::string& path) const;
+
+	bool contains(const LookupKey& key) const;
+	size_t count(const LookupKey& key) const;
+
+	//Номерът на слота на ключа в [0, size()), или NPOS. Може да се ползва за индекс в паралелни масиви.
+	size_t index_of(const LookupKey& key) const;
+
+	template<typename Function>
+	void for_each(const Function& func) const;
+
+	size_t size() const;
+	bool empty() const;
+
+	const void* data() const;
+	size_t byteSize() const;
+};
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+FrozenUnorderedSet<Key> freeze(const UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>& set)
+{
+	std::vector<const Key*> keys;
+	keys.reserve(set.size());
+	set.for_each([&keys](const Key& key) { keys.push_back(&key); });
+
+	return FrozenUnorderedSet<Key>::build(keys);
+}
+
+template<typename Key>
+FrozenUnorderedSet<Key> FrozenUnorderedSet<Key>::build(const std::vector<const Key*>& keys)
+{
+	uint64_t positions = keys.size() + keys.size() / EXTRA_POSITIONS_DIVISOR + 1;
+	if (positions >= UINT32_MAX)
+		throw std::length_error("FrozenUnorderedSet supports less than about 2^32 keys");
+
+	uint32_t n = static_cast<uint32_t>(keys.size());
+	uint32_t m = static_cast<uint32_t>(positions);
+	uint32_t groups = std::max<uint32_t>(1, static_cast<uint32_t>((n + KEYS_PER_GROUP - 1) / KEYS_PER_GROUP));
+
+	std::vector<uint64_t> hashes(n);
+	std::vector<uint32_t> displacementsTable(groups);
+	std::vector<uint32_t> positionOf(n);
+	std::vector<uint32_t> groupStart(groups + 1);
+	std::vector<uint32_t> order(n);
+	std::vector<uint32_t> groupsBySize(groups);
+	std::vector<bool> taken(m);
+	std::vector<uint32_t> candidate;
+
+	uint64_t currSeed = 0x243F6A8885A308D3ULL;
+	bool solved = false;
+	for (unsigned attempt = 0; attempt < MAX_SEED_ATTEMPTS && !solved; attempt++)
+	{
+		if (attempt > 0)
+			currSeed = FrozenHashing::mix(currSeed + 1);
+
+		//групиране на ключовете по група (counting sort)
+		std::fill(groupStart.begin(), groupStart.end(), 0);
+		for (uint32_t i = 0; i < n; i++)
+		{
+			hashes[i] = Codec::hash(*keys[i], currSeed);
+			groupStart[groupFor(hashes[i], groups) + 1]++;
+		}
+		for (uint32_t g = 0; g < groups; g++)
+			groupStart[g + 1] += groupStart[g];
+
+		std::vector<uint32_t> nextPos(groupStart.begin(), groupStart.end() - 1);
+		for (uint32_t i = 0; i < n; i++)
+			order[nextPos[groupFor(hashes[i], groups)]++] = i;
+
+		//първо се нареждат най-големите групи, докато има много свободни слотове
+		for (uint32_t g = 0; g < groups; g++)
+			groupsBySize[g] = g;
+		std::stable_sort(groupsBySize.begin(), groupsBySize.end(), [&groupStart](uint32_t lhs, uint32_t rhs) {
+			return groupStart[lhs + 1] - groupStart[lhs] > groupStart[rhs + 1] - groupStart[rhs];
+		});
+
+		std::fill(taken.begin(), taken.end(), false);
+		std::fill(displacementsTable.begin(), displacementsTable.end(), 0);
+		solved = true;
+
+		for (uint32_t g : groupsBySize)
+		{
+			uint32_t from = groupStart[g], to = groupStart[g + 1];
+			if (from == to)
+				break;
+
+			uint32_t displacement = 0;
+			for (; displacement < MAX_DISPLACEMENT; displacement++)
+			{
+				candidate.clear();
+				bool fits = true;
+				for (uint32_t j = from; j < to && fits; j++)
+				{
+					uint32_t position = positionFor(hashes[order[j]], displacement, m);
+					fits = !taken[position] && std::find(candidate.begin(), candidate.end(), position) == candidate.end();
+					candidate.push_back(position);
+				}
+
+				if (fits)
+					break;
+			}
+
+			if (displacement == MAX_DISPLACEMENT)
+			{
+				solved = false;
+				break;
+			}
+
+			displacementsTable[g] = displacement;
+			for (uint32_t j = from; j < to; j++)
+			{
+				positionOf[order[j]] = candidate[j - from];
+				taken[candidate[j - from]] = true;
+			}
+		}
+	}
+
+	//два ключа с еднакъв 64-битов хеш при всеки seed означават повтарящ се ключ, а не лош късмет
+	if (!solved)
+		throw std::runtime_error("Cannot build a perfect hash for these keys");
+
+	//заетите позиции в [n, m) са точно толкова, колкото празните слотове в [0, n)
+	std::vector<uint32_t> remapTable(m - n, 0);
+	uint32_t freeSlot = 0;
+	for (uint32_t p = n; p < m; p++)
+	{
+		if (!taken[p])
+			continue;
+		while (taken[freeSlot])
+			freeSlot++;
+		remapTable[p - n] = freeSlot++;
+	}
+
+	size_t poolSize = 0;
+	for (const Key* key : keys)
+		poolSize += Codec::poolBytes(*key);
+
+	Header header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.keyKind = Codec::KIND;
+	header.slotSize = sizeof(Slot);
+	header.seed = currSeed;
+	header.keysCount = n;
+	header.groupsCount = groups;
+	header.positionsCount = m;
+	header.displacementsOffset = alignUp(sizeof(Header));
+	header.remapOffset = alignUp(header.displacementsOffset + groups * sizeof(uint32_t));
+	header.slotsOffset = alignUp(header.remapOffset + static_cast<size_t>(m - n) * sizeof(uint32_t));
+	header.poolOffset = alignUp(header.slotsOffset + static_cast<size_t>(n) * sizeof(Slot));
+	header.totalSize = alignUp(header.poolOffset + poolSize);
+
+	FrozenUnorderedSet result;
+	result.ownedBuffer.assign(header.totalSize / sizeof(uint64_t), 0);
+	char* data = reinterpret_cast<char*>(result.ownedBuffer.data());
+
+	std::memcpy(data, &header, sizeof(Header));
+	std::memcpy(data + header.displacementsOffset, displacementsTable.data(), groups * sizeof(uint32_t));
+	std::memcpy(data + header.remapOffset, remapTable.data(), remapTable.size() * sizeof(uint32_t));
+
+	size_t poolUsed = 0;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		uint32_t slotIndex = positionOf[i] < n ? positionOf[i] : remapTable[positionOf[i] - n];
+		Slot slot = Codec::makeSlot(*keys[i], hashes[i], data + header.poolOffset, poolUsed);
+		std::memcpy(data + header.slotsOffset + static_cast<size_t>(slotIndex) * sizeof(Slot), &slot, sizeof(Slot));
+	}
+
+	result.attach(data, header.totalSize);
+	return result;
+}
+
+template<typename Key>
+void FrozenUnorderedSet<Key>::attach(const char* data, size_t size)
+{
+	Header header;
+	if (size < sizeof(Header))
+		throw std::runtime_error("Frozen set buffer is too small");
+	std::memcpy(&header, data, sizeof(Header));
+
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+		throw std::runtime_error("Not a frozen set buffer");
+	if (header.byteOrder != BYTE_ORDER_MARK)
+		throw std::runtime_error("Frozen set was written on a machine with different byte order");
+	if (header.keyKind != Codec::KIND || header.slotSize != sizeof(Slot))
+		throw std::runtime_error("Frozen set was written for a different key type");
+	//сумите отместване + размер се сравняват с изваждане, за да не препълнят
+	if (header.totalSize > size || header.keysCount >= UINT32_MAX || header.positionsCount > UINT32_MAX
+		|| header.positionsCount <= header.keysCount || header.groupsCount == 0 || header.groupsCount > UINT32_MAX
+		|| header.displacementsOffset < sizeof(Header) || header.poolOffset > header.totalSize
+		|| !rangeFits(header.displacementsOffset, header.groupsCount, sizeof(uint32_t), header.remapOffset)
+		|| !rangeFits(header.remapOffset, header.positionsCount - header.keysCount, sizeof(uint32_t), header.slotsOffset)
+		|| !rangeFits(header.slotsOffset, header.keysCount, sizeof(Slot), header.poolOffset))
+		throw std::runtime_error("Frozen set buffer is corrupted");
+
+	const uint32_t* displacementsTable = reinterpret_cast<const uint32_t*>(data + header.displacementsOffset);
+	for (uint64_t g = 0; g < header.groupsCount; g++)
+	{
+		if (displacementsTable[g] >= MAX_DISPLACEMENT)
+			throw std::runtime_error("Frozen set buffer is corrupted");
+	}
+
+	const uint32_t* remapTable = reinterpret_cast<const uint32_t*>(data + header.remapOffset);
+	for (uint64_t p = 0; p < header.positionsCount - header.keysCount; p++)
+	{
+		if (header.keysCount > 0 && remapTable[p] >= header.keysCount)
+			throw std::runtime_error("Frozen set buffer is corrupted");
+	}
+
+	const Slot* slotsTable = reinterpret_cast<const Slot*>(data + header.slotsOffset);
+	size_t poolSize = static_cast<size_t>(header.totalSize - header.poolOffset);
+	for (uint64_t i = 0; i < header.keysCount; i++)
+	{
+		if (!Codec::fitsPool(slotsTable[i], poolSize))
+			throw std::runtime_error("Frozen set buffer is corrupted");
+	}
+
+	buffer = data;
+	bufferSize = static_cast<size_t>(header.totalSize);
+	seed = header.seed;
+	keysCount = static_cast<uint32_t>(header.keysCount);
+	groupsCount = static_cast<uint32_t>(header.groupsCount);
+	positionsCount = static_cast<uint32_t>(header.positionsCount);
+	displacements = displacementsTable;
+	remap = remapTable;
+	slots = slotsTable;
+	pool = data + header.poolOffset;
+}
+
+template<typename Key>
+void FrozenUnorderedSet<Key>::detach()
+{
+	buffer = nullptr;
+	bufferSize = 0;
+	seed = 0;
+	keysCount = 0;
+	groupsCount = 0;
+	positionsCount = 0;
+	displacements = nullptr;
+	remap = nullptr;
+	slots = nullptr;
+	pool = nullptr;
+}
+
+template<typename Key>
+FrozenUnorderedSet<Key>::FrozenUnorderedSet(FrozenUnorderedSet&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+template<typename Key>
+FrozenUnorderedSet<Key>& FrozenUnorderedSet<Key>::operator=(FrozenUnorderedSet&& other) noexcept
+{
+	if (this != &other)
+	{
+		//буферът на vector и картирането не се местят в паметта, така че указателите остават валидни
+		ownedBuffer = std::move(other.ownedBuffer);
+		mapping = std::move(other.mapping);
+		buffer = other.buffer;
+		bufferSize = other.bufferSize;
+		seed = other.seed;
+		keysCount = other.keysCount;
+		groupsCount = other.groupsCount;
+		positionsCount = other.positionsCount;
+		displacements = other.displacements;
+		remap = other.remap;
+		slots = other.slots;
+		pool = other.pool;
+
+		other.ownedBuffer.clear();
+		other.detach();
+	}
+	return *this;
+}
+
+template<typename Key>
+FrozenUnorderedSet<Key> FrozenUnorderedSet<Key>::mapFile(const std::string& path)
+{
+	FrozenUnorderedSet result;
+	result.mapping = ReadOnlyFileMapping(path);
+	result.attach(result.mapping.getData(), result.mapping.size());
+	return result;
+}
+
+template<typename Key>
+void FrozenUnorderedSet<Key>::writeToFile(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(buffer, static_cast<std::streamsize>(bufferSize));
+	file.close();
+
+	if (!file)
+		throw std::runtime_error("Cannot write " + path);
+}
+
+template<typename Key>
+size_t FrozenUnorderedSet<Key>::index_of(const LookupKey& key) const
+{
+	if (keysCount == 0)
+		return NPOS;
+
+	uint64_t hash = Codec::hash(key, seed);
+	uint32_t slot = positionFor(hash, displacements[groupFor(hash, groupsCount)], positionsCount);
+	if (slot >= keysCount)
+		slot = remap[slot - keysCount];
+	return Codec::matches(slots[slot], key, hash, pool) ? slot : NPOS;
+}
+
+template<typename Key>
+bool FrozenUnorderedSet<Key>::contains(const LookupKey& key) const
+{
+	return index_of(key) != NPOS;
+}
+
+template<typename Key>
+size_t FrozenUnorderedSet<Key>::count(const LookupKey& key) const
+{
+	return contains(key) ? 1 : 0;
+}
+
+template<typename Key>
+template<typename Function>
+void FrozenUnorderedSet<Key>::for_each(const Function& func) const
+{
+	for (uint32_t i = 0; i < keysCount; i++)
+		func(Codec::view(slots[i], pool));
+}
+
+template<typename Key>
+size_t FrozenUnorderedSet<Key>::size() const
+{
+	return keysCount;
+}
+
+template<typename Key>
+bool FrozenUnorderedSet<Key>::empty() const
+{
+	return keysCount == 0;
+}
+
+template<typename Key>
+const void* FrozenUnorderedSet<Key>::data() const
+{
+	return buffer;
+}
+
+template<typename Key>
+size_t FrozenUnorderedSet<Key>::byteSize() const
+{
+	return bufferSize;
+}
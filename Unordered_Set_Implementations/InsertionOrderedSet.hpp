@@ -1,26 +1,106 @@
-﻿#include <iostream>
-#include <list>
-#include <vector>
-#include <forward_list>
+﻿#pragma once
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
 
+//Подредено по добавяне множество с устройството на dict в CPython:
+//	- entries - ключовете и хешовете им подред на добавяне, в един непрекъснат масив;
+//	- index - таблица с отворено адресиране, която пази само номера на запис (+1) в entries.
+//Клетките на index са 8, 16 или 32 бита според размера на таблицата, затова за малки множества тя е няколко байта на ключ.
+//Изтритият запис остава в entries като tombstone, а клетката му в index става DELETED. Записите се уплътняват,
+//когато entries се напълни - тогава index се строи наново за живите ключове.
+//Всеки запис помни клетката си в index, затова изтриване по итератор (и pop_front, и изхвърляне) не търси наново.
+//Обхождането е линейно по entries. Добавяне може да уплътни entries и да обезсили итераторите.
+//С max_size множеството става LRU кеш: touch премества ключ в края, а при препълване се изхвърлят най-старите.
+//Записите може да носят и време на добавяне (в отделен масив, само ако се ползва) - тогава expire_before
+//маха изтеклите ключове от началото, а expire_after прави това автоматично при всяко добавяне.
+//След track_positions() nth, index_of и it + n ползват дърво на Фенуик над позициите в entries
+//(1 за жив запис, 0 за tombstone), което всяко добавяне и изтриване поддържа - O(log n). Без него са линейни.
+//Дървото се строи само в неконстантни методи, така че едновременните четения не променят множеството.
 template<typename Key, typename Hash = std::hash<Key>>
 class InsertionOrderedSet
 {
+public:
+	using Clock = std::chrono::steady_clock;
+	using TimePoint = Clock::time_point;
 private:
-	std::list<Key> data;
-	std::vector<std::forward_list<typename std::list<Key>::iterator>> hashTable;
-	double maxLoadFactor = 0.75;
+	struct Entry
+	{
+		size_t hash;
+		uint32_t indexSlot; //клетката в index, която сочи към записа, или NO_SLOT за изтрит запис
+		Key key;
+	};
+
+	static constexpr size_t MIN_INDEX_SIZE = 8;
+	static constexpr size_t EMPTY = 0;
+	static constexpr size_t NPOS = SIZE_MAX;
+	static constexpr uint32_t NO_SLOT = UINT32_MAX;
+	static constexpr size_t MAX_INDEX_SIZE = static_cast<size_t>(1) << 31; //клетките и номерата на записи се събират в 32 бита
+	static constexpr unsigned PERTURB_SHIFT = 5;
+
+	std::vector<Entry> entries;
+	size_t liveCount = 0;
+	size_t firstEntry = 0; //първият жив запис или entries.size(). Поддържа се от промените, а не от const методите.
+
+	std::vector<uint8_t> index;
+	size_t indexSize = 0; //степен на двойката
+	unsigned indexWidth = 1; //байтове на клетка
+
+	size_t maxSize = SIZE_MAX;
+	std::function<void(const Key&)> onEvict;
+
+	//timestamps[i] е времето на entries[i]. Времената не намаляват, затова изтеклите са винаги в началото.
+	bool timestamped = false;
+	std::vector<TimePoint> timestamps;
+	TimePoint latestTime = TimePoint::min();
+	Clock::duration expiryWindow = Clock::duration::max(); //max - без автоматично изтичане
+
+	//liveTree[i - 1] е броят живи записи в позициите (i - lowbit(i), i]. Размерът е usableSize().
+	bool ranked = false;
+	std::vector<uint32_t> liveTree;
 
 	Hash getHash;
-	void resize();
-	size_t getHashCode(const Key& element) const;
+
+	size_t deletedMark() const; //най-голямата стойност за текущата ширина
+	size_t getIndexSlot(size_t i) const;
+	void setIndexSlot(size_t i, size_t value);
+	size_t usableSize() const; //колко записа (живи и изтрити) побира index, преди да се строи наново
+
+	//Клетката на index, сочеща към ключа, или NPOS
+	size_t findIndexSlot(const Key& key, size_t hash) const;
+	size_t findFreeIndexSlot(size_t hash) const;
+
+	//Маха изтритите записи и строи index с място за поне minCapacity ключа
+	void rebuild(size_t minCapacity);
+	void removeEntry(size_t position);
+	size_t appendEntry(Entry&& entry, TimePoint time); //връща позицията на записа
+	size_t moveEntryToBack(size_t position, TimePoint time);
+	void evictOverflow();
+
+	void enableTimestamps(); //по-старите записи получават TimePoint::min()
+	TimePoint advanceTime(TimePoint time); //не позволява времето да намалява
+
+	size_t firstLive() const;
+	size_t nextLive(size_t position) const; //следващият жив запис след position или entries.size()
+	size_t prevLive(size_t position) const; //предишният жив запис или position, ако няма такъв
+
+	void buildLiveTree();
+	void updateLiveTree(size_t position, int delta);
+	size_t rankOf(size_t position) const; //брой живи записи преди position
+	size_t positionOfRank(size_t rank) const; //позицията на живия запис с този номер или entries.size()
 public:
 	class Iterator 
 	{
 	private:
-		typename std::list<Key>::iterator currElementIter;
-		Iterator(typename std::list<Key>::iterator curr) : currElementIter(curr) {};
+		InsertionOrderedSet* set;
+		size_t position; //== entries.size() за end()
+		Iterator(InsertionOrderedSet* _set, size_t _position) : set(_set), position(_position) {};
 		friend class InsertionOrderedSet;
 	public:
 		Key& operator*() const;
@@ -44,8 +124,9 @@ public:
 	class ConstIterator
 	{
 	private:
-		typename std::list<Key>::const_iterator currElementIter;
-		ConstIterator(typename std::list<Key>::const_iterator curr) : currElementIter(curr) {};
+		const InsertionOrderedSet* set;
+		size_t position;
+		ConstIterator(const InsertionOrderedSet* _set, size_t _position) : set(_set), position(_position) {};
 		friend class InsertionOrderedSet;
 	public:
 		const Key& operator*() const;
@@ -67,15 +148,37 @@ public:
 	
 	InsertionOrderedSet();
 	void print() const;
-	void insert(const Key& key);
-	void remove(const Key& key);
-	void remove(Iterator it);
+	bool insert(const Key& key); //false, ако ключът вече го има. При записи с време то е Clock::now().
+	bool insert(const Key& key, TimePoint time);
+	bool remove(const Key& key);
+	bool remove(Iterator it); //false за end() или вече изтрит ключ
+
+	//Изтрива всички ключове от диапазона и връща броя изтрити. Ако след това tombstone-ите са повече
+	//от живите записи, entries се уплътнява веднага (и итераторите се обезсилват).
+	template<typename InputIt>
+	size_t remove_all(InputIt first, InputIt last);
+	template<typename Range>
+	size_t remove_all(const Range& keys);
+
 	ConstIterator find(const Key& element) const;
+	bool contains(const Key& element) const;
+
+	//Строи и оттук нататък поддържа дървото на позициите (4 байта на запис)
+	void track_positions();
+
+	//n-тият (от 0) ключ подред на добавяне или end(), ако ключовете са по-малко.
+	//O(log n) след track_positions(), иначе O(n).
+	Iterator nth(size_t n);
+	ConstIterator nth(size_t n) const;
+	size_t index_of(const Key& element) const; //SIZE_MAX, ако ключа го няма
 	void clear();
 	bool empty() const;
+	size_t size() const;
 
+	//Връща броя изтрити ключове. Записите се уплътняват веднага след обхождането.
+	//Ако predicate хвърли, вече изтритите остават изтрити, а множеството е валидно.
 	template<typename Functor>
-	void erase_if(Functor predicate);
+	size_t erase_if(Functor predicate);
 
 	Iterator begin();
 	Iterator end();
@@ -84,218 +187,753 @@ public:
 	ConstIterator cend() const;
 
 	double loadFactor() const;
+
+	//Премества ключа в края на реда (най-скоро използван) - изтрива записа и добавя нов, без ново търсене.
+	//Връща false, ако ключа го няма. Версията с време, както insert с време, включва времената и изтрива изтеклите ключове.
+	bool touch(const Key& key);
+	bool touch(const Key& key, TimePoint time);
+	Iterator move_to_back(Iterator it); //връща итератор към преместения ключ или end() за end() и вече изтрит ключ
+
+	const Key& front() const; //най-старият ключ
+	const Key& back() const; //най-новият ключ
+	void pop_front();
+
+	//При повече от maxSize ключа insert изхвърля най-старите и вика callback-а за всеки от тях
+	void max_size(size_t maxSize);
+	size_t max_size() const;
+	void eviction_callback(std::function<void(const Key&)> callback); //вика се и за изтеклите ключове
+
+	//Маха от началото ключовете с време преди time и връща броя им - O(изтекли)
+	size_t expire_before(TimePoint time);
+
+	//При всяко добавяне с време t първо изтичат ключовете, по-стари от t - window.
+	//Clock::duration::max() спира автоматичното изтичане.
+	void expire_after(Clock::duration window);
+
+	//Байтове, заявени от алокатора: обектът, entries, index и помощните масиви
+	size_t memory_usage() const;
 };
 
 template<typename Key, typename Hash>
-void InsertionOrderedSet<Key, Hash>::resize()
+size_t InsertionOrderedSet<Key, Hash>::deletedMark() const
+{
+	return (static_cast<size_t>(1) << (indexWidth * 8)) - 1;
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::getIndexSlot(size_t i) const
+{
+	const uint8_t* cell = index.data() + i * indexWidth;
+	switch (indexWidth)
+	{
+	case 1:
+		return *cell;
+	case 2:
+	{
+		uint16_t value;
+		std::memcpy(&value, cell, sizeof(value));
+		return value;
+	}
+	default:
+	{
+		uint32_t value;
+		std::memcpy(&value, cell, sizeof(value));
+		return value;
+	}
+	}
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::setIndexSlot(size_t i, size_t value)
+{
+	uint8_t* cell = index.data() + i * indexWidth;
+	switch (indexWidth)
+	{
+	case 1:
+		*cell = static_cast<uint8_t>(value);
+		break;
+	case 2:
+	{
+		uint16_t narrow = static_cast<uint16_t>(value);
+		std::memcpy(cell, &narrow, sizeof(narrow));
+		break;
+	}
+	default:
+	{
+		uint32_t narrow = static_cast<uint32_t>(value);
+		std::memcpy(cell, &narrow, sizeof(narrow));
+		break;
+	}
+	}
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::usableSize() const
 {
-	size_t newSize = hashTable.size() * 2;
-	std::vector<std::forward_list<typename std::list<Key>::iterator>> newHashTable(newSize);
-	for (auto it = data.begin(); it != data.end(); ++it) 
+	return indexSize * 2 / 3;
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::findIndexSlot(const Key& key, size_t hash) const
+{
+	//пробване като в CPython: i = 5 * i + 1 + perturb, така че и старшите битове на хеша участват
+	size_t deleted = deletedMark();
+	size_t mask = indexSize - 1;
+	size_t perturb = hash;
+	for (size_t i = hash & mask; ; i = (i * 5 + perturb + 1) & mask)
 	{
-		size_t newHashCode = getHash(*it) % newSize;
-		newHashTable[newHashCode].push_front(it);
+		size_t value = getIndexSlot(i);
+		if (value == EMPTY)
+			return NPOS;
+
+		if (value != deleted)
+		{
+			const Entry& entry = entries[value - 1];
+			if (entry.hash == hash && entry.key == key)
+				return i;
+		}
+		perturb >>= PERTURB_SHIFT;
 	}
+}
 
-	hashTable = std::move(newHashTable);
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::findFreeIndexSlot(size_t hash) const
+{
+	size_t deleted = deletedMark();
+	size_t mask = indexSize - 1;
+	size_t perturb = hash;
+	for (size_t i = hash & mask; ; i = (i * 5 + perturb + 1) & mask)
+	{
+		size_t value = getIndexSlot(i);
+		if (value == EMPTY || value == deleted)
+			return i;
+		perturb >>= PERTURB_SHIFT;
+	}
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::rebuild(size_t minCapacity)
+{
+	//като GROWTH_RATE в CPython - място за поне още толкова ключове преди следващото строене
+	size_t newIndexSize = MIN_INDEX_SIZE;
+	while (newIndexSize * 2 / 3 < minCapacity * 2)
+		newIndexSize *= 2;
+
+	if (newIndexSize > MAX_INDEX_SIZE)
+		throw std::length_error("InsertionOrderedSet is too large");
+
+	//entries никога не надхвърля usableSize(), затова новият масив се заделя точно толкова голям
+	std::vector<Entry> live;
+	std::vector<TimePoint> liveTimestamps;
+	live.reserve(newIndexSize * 2 / 3);
+	if (timestamped)
+		liveTimestamps.reserve(newIndexSize * 2 / 3);
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].indexSlot == NO_SLOT)
+			continue;
+
+		live.push_back(std::move(entries[i]));
+		if (timestamped)
+			liveTimestamps.push_back(timestamps[i]);
+	}
+	entries.swap(live);
+	timestamps.swap(liveTimestamps);
+	firstEntry = 0;
+
+	//най-голямата стойност на клетката е запазена за DELETED
+	indexSize = newIndexSize;
+	if (indexSize <= (static_cast<size_t>(1) << 7))
+		indexWidth = 1;
+	else if (indexSize <= (static_cast<size_t>(1) << 15))
+		indexWidth = 2;
+	else
+		indexWidth = 4;
+
+	index.assign(indexSize * indexWidth, 0);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		entries[i].indexSlot = static_cast<uint32_t>(findFreeIndexSlot(entries[i].hash));
+		setIndexSlot(entries[i].indexSlot, i + 1);
+	}
+
+	if (ranked)
+		buildLiveTree();
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::removeEntry(size_t position)
+{
+	setIndexSlot(entries[position].indexSlot, deletedMark());
+	entries[position].indexSlot = NO_SLOT;
+	liveCount--;
+
+	//границата само расте до следващото уплътняване, затова изтриването отпред е амортизирано O(1)
+	if (position == firstEntry)
+	{
+		while (firstEntry < entries.size() && entries[firstEntry].indexSlot == NO_SLOT)
+			firstEntry++;
+	}
+	if (ranked)
+		updateLiveTree(position, -1);
 }
 
 template<typename Key, typename Hash>
-size_t InsertionOrderedSet<Key, Hash>::getHashCode(const Key& element) const
+size_t InsertionOrderedSet<Key, Hash>::appendEntry(Entry&& entry, TimePoint time)
 {
-	return getHash(element) % hashTable.size();
+	if (entries.size() + 1 > usableSize())
+		rebuild(liveCount + 1);
+
+	entry.indexSlot = static_cast<uint32_t>(findFreeIndexSlot(entry.hash));
+	setIndexSlot(entry.indexSlot, entries.size() + 1);
+	entries.push_back(std::move(entry));
+	if (timestamped)
+		timestamps.push_back(time);
+	liveCount++;
+	if (ranked)
+		updateLiveTree(entries.size() - 1, 1);
+	return entries.size() - 1;
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::moveEntryToBack(size_t position, TimePoint time)
+{
+	if (position + 1 == entries.size())
+	{
+		if (timestamped)
+			timestamps[position] = time;
+		return position;
+	}
+
+	//старият запис става tombstone, а уплътняването в appendEntry го маха
+	Entry entry = std::move(entries[position]);
+	removeEntry(position);
+	return appendEntry(std::move(entry), time);
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::evictOverflow()
+{
+	while (liveCount > maxSize)
+	{
+		size_t position = firstLive();
+		if (onEvict)
+			onEvict(entries[position].key);
+		removeEntry(position);
+	}
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::enableTimestamps()
+{
+	if (timestamped)
+		return;
+
+	timestamped = true;
+	timestamps.reserve(entries.capacity());
+	timestamps.assign(entries.size(), TimePoint::min());
+}
+
+template<typename Key, typename Hash>
+typename InsertionOrderedSet<Key, Hash>::TimePoint InsertionOrderedSet<Key, Hash>::advanceTime(TimePoint time)
+{
+	latestTime = std::max(latestTime, time);
+	return latestTime;
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::buildLiveTree()
+{
+	//всеки възел добавя сумата си към родителя - O(n)
+	ranked = true;
+	liveTree.assign(usableSize(), 0);
+	for (size_t i = 0; i < entries.size(); i++)
+		liveTree[i] = entries[i].indexSlot != NO_SLOT;
+
+	for (size_t i = 1; i <= liveTree.size(); i++)
+	{
+		size_t parent = i + (i & (0 - i));
+		if (parent <= liveTree.size())
+			liveTree[parent - 1] += liveTree[i - 1];
+	}
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::updateLiveTree(size_t position, int delta)
+{
+	for (size_t i = position + 1; i <= liveTree.size(); i += i & (0 - i))
+		liveTree[i - 1] += delta;
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::rankOf(size_t position) const
+{
+	if (position >= entries.size())
+		return liveCount;
+
+	size_t rank = 0;
+	if (!ranked)
+	{
+		for (size_t i = firstEntry; i < position; i++)
+			rank += entries[i].indexSlot != NO_SLOT;
+		return rank;
+	}
+
+	for (size_t i = position; i > 0; i -= i & (0 - i))
+		rank += liveTree[i - 1];
+	return rank;
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::positionOfRank(size_t rank) const
+{
+	if (rank >= liveCount)
+		return entries.size();
+
+	if (!ranked)
+	{
+		size_t position = firstEntry;
+		for (; rank > 0; rank--)
+			position = nextLive(position);
+		return position;
+	}
+
+	//спускане по степените на двойката: най-дългият префикс с не повече от rank живи записа
+	size_t step = 1;
+	while (step * 2 <= liveTree.size())
+		step *= 2;
+
+	size_t position = 0;
+	for (; step > 0; step /= 2)
+	{
+		if (position + step <= liveTree.size() && liveTree[position + step - 1] <= rank)
+		{
+			position += step;
+			rank -= liveTree[position - 1];
+		}
+	}
+	return position;
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::firstLive() const
+{
+	return firstEntry;
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::nextLive(size_t position) const
+{
+	if (position >= entries.size())
+		return entries.size();
+
+	position++;
+	while (position < entries.size() && entries[position].indexSlot == NO_SLOT)
+		position++;
+	return position;
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::prevLive(size_t position) const
+{
+	for (size_t i = position; i > firstEntry; i--)
+	{
+		if (entries[i - 1].indexSlot != NO_SLOT)
+			return i - 1;
+	}
+	return position;
 }
 
 template<typename Key, typename Hash>
 InsertionOrderedSet<Key, Hash>::InsertionOrderedSet()
 {
-	hashTable.resize(8);
+	rebuild(0);
 }
 
 template<typename Key, typename Hash>
 void InsertionOrderedSet<Key, Hash>::print() const
 {
-	for (auto it = data.begin(); it != data.end(); it++) 
+	for (auto it = cbegin(); it != cend(); it++) 
 		std::cout << *it << ' ';
 
 	std::cout << std::endl;
 }
 
 template<typename Key, typename Hash>
-void InsertionOrderedSet<Key, Hash>::insert(const Key& key) //?
+bool InsertionOrderedSet<Key, Hash>::insert(const Key& key)
 {
-	if (loadFactor() >= maxLoadFactor)
-		resize();
+	if (timestamped)
+		return insert(key, Clock::now());
 
-	size_t hashCode = getHashCode(key);
-	auto& bucket = hashTable[hashCode];
-	auto iter = std::find_if(bucket.begin(), bucket.end(), [key](auto& iter) { return key == *iter;});
+	size_t hash = getHash(key);
+	if (findIndexSlot(key, hash) != NPOS)
+		return false;
 
-	if (iter != hashTable[hashCode].end())
-		return;
-	else
+	appendEntry({ hash, NO_SLOT, key }, TimePoint());
+	evictOverflow();
+	return true;
+}
+
+template<typename Key, typename Hash>
+bool InsertionOrderedSet<Key, Hash>::insert(const Key& key, TimePoint time)
+{
+	enableTimestamps();
+	time = advanceTime(time);
+
+	//изтеклото копие на ключа се маха преди търсенето, така че ключът се добавя наново
+	if (expiryWindow != Clock::duration::max())
+		expire_before(time - expiryWindow);
+
+	size_t hash = getHash(key);
+	if (findIndexSlot(key, hash) != NPOS)
+		return false;
+
+	appendEntry({ hash, NO_SLOT, key }, time);
+	evictOverflow();
+	return true;
+}
+
+template<typename Key, typename Hash>
+bool InsertionOrderedSet<Key, Hash>::remove(const Key& key)
+{
+	size_t indexSlot = findIndexSlot(key, getHash(key));
+	if (indexSlot == NPOS)
+		return false;
+
+	removeEntry(getIndexSlot(indexSlot) - 1);
+	return true;
+}
+
+template<typename Key, typename Hash>
+bool InsertionOrderedSet<Key, Hash>::remove(Iterator it)
+{
+	if (it.position >= entries.size() || entries[it.position].indexSlot == NO_SLOT)
+		return false;
+
+	removeEntry(it.position);
+	return true;
+}
+
+template<typename Key, typename Hash>
+template<typename InputIt>
+size_t InsertionOrderedSet<Key, Hash>::remove_all(InputIt first, InputIt last)
+{
+	size_t removedCount = 0;
+	for (; first != last; ++first)
 	{
-		data.emplace_back(key);
-		hashTable[hashCode].push_front(--data.end());
+		if (remove(*first))
+			removedCount++;
 	}
+
+	if (entries.size() - liveCount > liveCount)
+		rebuild(liveCount);
+	return removedCount;
 }
 
 template<typename Key, typename Hash>
-void InsertionOrderedSet<Key, Hash>::remove(const Key& key)
+template<typename Range>
+size_t InsertionOrderedSet<Key, Hash>::remove_all(const Range& keys)
 {
-	size_t hashCode = getHashCode(key);
-	auto& bucket = hashTable[hashCode];
-	bucket.remove_if([this, key](const auto& it) {
-		if (*it == key) {
-			data.erase(it);
-			return true;
-		}
-		else {
-			return false;
-		}
-	});
+	return remove_all(std::begin(keys), std::end(keys));
 }
 
 template<typename Key, typename Hash>
-void InsertionOrderedSet<Key, Hash>::remove(Iterator it)
+typename InsertionOrderedSet<Key, Hash>::ConstIterator InsertionOrderedSet<Key, Hash>::find(const Key& element) const
 {
-	const Key& key = *it;
-	size_t hashCode = getHashCode(key);
-	auto& bucket = hashTable[hashCode];
-	bucket.remove_if([&key](const Key& elem) {
-		return elem == key;
-	});
-	data.erase(it);
+	size_t indexSlot = findIndexSlot(element, getHash(element));
+	if (indexSlot == NPOS)
+		return cend();
+
+	return ConstIterator(this, getIndexSlot(indexSlot) - 1);
 }
 
 template<typename Key, typename Hash>
-typename InsertionOrderedSet<Key, Hash>::ConstIterator InsertionOrderedSet<Key, Hash>::find(const Key& element) const
+bool InsertionOrderedSet<Key, Hash>::contains(const Key& element) const
 {
-	size_t hashCode = getHashCode(element);
-	auto& bucket = hashTable[hashCode];
+	return findIndexSlot(element, getHash(element)) != NPOS;
+}
 
-	auto it = std::find_if(bucket.begin(), bucket.end(), [&element](auto& iter) { return element == *iter; }); //wrong
-	if (it == bucket.end())
-		return ConstIterator(data.end());
-	else
-		return ConstIterator(it);
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::track_positions()
+{
+	if (!ranked)
+		buildLiveTree();
+}
+
+template<typename Key, typename Hash>
+typename InsertionOrderedSet<Key, Hash>::Iterator InsertionOrderedSet<Key, Hash>::nth(size_t n)
+{
+	return Iterator(this, positionOfRank(n));
+}
+
+template<typename Key, typename Hash>
+typename InsertionOrderedSet<Key, Hash>::ConstIterator InsertionOrderedSet<Key, Hash>::nth(size_t n) const
+{
+	return ConstIterator(this, positionOfRank(n));
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::index_of(const Key& element) const
+{
+	size_t indexSlot = findIndexSlot(element, getHash(element));
+	if (indexSlot == NPOS)
+		return SIZE_MAX;
+
+	return rankOf(getIndexSlot(indexSlot) - 1);
 }
 
 template<typename Key, typename Hash>
 void InsertionOrderedSet<Key, Hash>::clear()
 {
-	data.clear();
-	hashTable.clear(); 
-	hashTable.resize(8);
+	std::vector<Entry>().swap(entries);
+	std::vector<TimePoint>().swap(timestamps);
+	std::vector<uint32_t>().swap(liveTree);
+	liveCount = 0;
+	rebuild(0);
 }
 
 template<typename Key, typename Hash>
 bool InsertionOrderedSet<Key, Hash>::empty() const
 {
-	return data.size() == 0;
+	return liveCount == 0;
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::size() const
+{
+	return liveCount;
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::Iterator InsertionOrderedSet<Key, Hash>::begin()
 {
-	return Iterator(data.begin());
+	return Iterator(this, firstLive());
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::Iterator InsertionOrderedSet<Key, Hash>::end()
 {
-	return Iterator(data.end());
+	return Iterator(this, entries.size());
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::ConstIterator InsertionOrderedSet<Key, Hash>::cbegin() const
 {
-	InsertionOrderedSet<Key, Hash>::ConstIterator toReturn(data.begin());
-	return toReturn;
+	return ConstIterator(this, firstLive());
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key,Hash>::ConstIterator InsertionOrderedSet<Key, Hash>::cend() const
 {
-	InsertionOrderedSet<Key, Hash>::ConstIterator toReturn(data.end());
-	return toReturn;
+	return ConstIterator(this, entries.size());
 }
 
 template<typename Key, typename Hash>
 double InsertionOrderedSet<Key, Hash>::loadFactor() const
 {
-	return static_cast<double>(data.size()) / hashTable.size();
+	return static_cast<double>(liveCount) / indexSize;
+}
+
+template<typename Key, typename Hash>
+bool InsertionOrderedSet<Key, Hash>::touch(const Key& key)
+{
+	if (timestamped)
+		return touch(key, Clock::now());
+
+	size_t indexSlot = findIndexSlot(key, getHash(key));
+	if (indexSlot == NPOS)
+		return false;
+
+	moveEntryToBack(getIndexSlot(indexSlot) - 1, TimePoint());
+	return true;
+}
+
+template<typename Key, typename Hash>
+bool InsertionOrderedSet<Key, Hash>::touch(const Key& key, TimePoint time)
+{
+	enableTimestamps();
+	time = advanceTime(time);
+
+	//изтекъл ключ не се подновява - той се маха и touch връща false
+	if (expiryWindow != Clock::duration::max())
+		expire_before(time - expiryWindow);
+
+	size_t indexSlot = findIndexSlot(key, getHash(key));
+	if (indexSlot == NPOS)
+		return false;
+
+	moveEntryToBack(getIndexSlot(indexSlot) - 1, time);
+	return true;
+}
+
+template<typename Key, typename Hash>
+typename InsertionOrderedSet<Key, Hash>::Iterator InsertionOrderedSet<Key, Hash>::move_to_back(Iterator it)
+{
+	if (it.position >= entries.size() || entries[it.position].indexSlot == NO_SLOT)
+		return end();
+
+	return Iterator(this, moveEntryToBack(it.position, timestamped ? advanceTime(Clock::now()) : TimePoint()));
+}
+
+template<typename Key, typename Hash>
+const Key& InsertionOrderedSet<Key, Hash>::front() const
+{
+	if (empty())
+		throw std::out_of_range("front() on an empty set");
+
+	return entries[firstLive()].key;
+}
+
+template<typename Key, typename Hash>
+const Key& InsertionOrderedSet<Key, Hash>::back() const
+{
+	if (empty())
+		throw std::out_of_range("back() on an empty set");
+
+	return entries[prevLive(entries.size())].key;
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::pop_front()
+{
+	if (empty())
+		throw std::out_of_range("pop_front() on an empty set");
+
+	removeEntry(firstLive());
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::max_size(size_t maxSize)
+{
+	if (maxSize == 0)
+		throw std::invalid_argument("max_size must be positive");
+
+	this->maxSize = maxSize;
+	evictOverflow();
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::max_size() const
+{
+	return maxSize;
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::eviction_callback(std::function<void(const Key&)> callback)
+{
+	onEvict = std::move(callback);
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::expire_before(TimePoint time)
+{
+	if (!timestamped)
+		return 0;
+
+	size_t expiredCount = 0;
+	for (size_t position = firstLive(); position < entries.size() && timestamps[position] < time; position = firstLive())
+	{
+		if (onEvict)
+			onEvict(entries[position].key);
+		removeEntry(position);
+		expiredCount++;
+	}
+	return expiredCount;
+}
+
+template<typename Key, typename Hash>
+void InsertionOrderedSet<Key, Hash>::expire_after(Clock::duration window)
+{
+	if (window < Clock::duration::zero())
+		throw std::invalid_argument("Expiry window must not be negative");
+
+	enableTimestamps();
+	expiryWindow = window;
+	if (window != Clock::duration::max() && latestTime != TimePoint::min())
+		expire_before(latestTime - window);
+}
+
+template<typename Key, typename Hash>
+size_t InsertionOrderedSet<Key, Hash>::memory_usage() const
+{
+	return sizeof(*this) + entries.capacity() * sizeof(Entry) + index.capacity() + timestamps.capacity() * sizeof(TimePoint)
+		+ liveTree.capacity() * sizeof(uint32_t);
 }
 
 template<typename Key, typename Hash>
 template<typename Functor>
-void InsertionOrderedSet<Key, Hash>::erase_if(Functor predicate)
+size_t InsertionOrderedSet<Key, Hash>::erase_if(Functor predicate)
 {
-	for (int i = 0; i < hashTable.size(); i++) 
+	//всеки запис става обикновен tombstone, така че при изключение от predicate множеството остава валидно
+	size_t erasedCount = 0;
+	for (size_t position = firstEntry; position < entries.size(); position++)
 	{
-		auto& curBucket = hashTable[i];
-		curBucket.remove_if([&predicate](const Key& elem) { predicate(elem); });
+		if (entries[position].indexSlot != NO_SLOT && predicate(entries[position].key))
+		{
+			removeEntry(position);
+			erasedCount++;
+		}
 	}
+
+	if (erasedCount > 0)
+		rebuild(liveCount);
+	return erasedCount;
 }
 
 template<typename Key, typename Hash>
 const Key& InsertionOrderedSet<Key, Hash>::ConstIterator::operator*() const
 {
-	return *currElementIter;
+	return set->entries[position].key;
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::ConstIterator InsertionOrderedSet<Key, Hash>::ConstIterator::operator+(int off) const
 {
-	//проверка дали излизаме извън рамките на data
 	ConstIterator res = *this;
 
-	while (off > 0) {
-		++res.currElementIter;
-		--off;
-	}
-	while (off < 0) {
-		--res.currElementIter;
-		++off;
+	//без дървото се върви по един жив запис наведнъж
+	if (!set->ranked)
+	{
+		while (off > 0) {
+			++res;
+			--off;
+		}
+		while (off < 0) {
+			--res;
+			++off;
+		}
+
+		return res;
 	}
 
+	//както при ++ и --, извън границите се спира на begin() или end()
+	size_t rank = set->rankOf(position);
+	if (off < 0)
+		rank -= std::min(rank, static_cast<size_t>(-static_cast<long long>(off)));
+	else
+		rank += static_cast<size_t>(off);
+
+	res.position = rank < set->liveCount ? set->positionOfRank(rank) : set->entries.size();
 	return res;
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::ConstIterator InsertionOrderedSet<Key, Hash>::ConstIterator::operator-(int off) const
 {
-	ConstIterator res = *this;
-	while (off > 0) {
-		--res.currElementIter;
-		++off;
-	}
-	while (off < 0) {
-		++res.currElementIter;
-		--off;
-	}
-
-	return res;
+	return *this + (-off);
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key,Hash>::ConstIterator& InsertionOrderedSet<Key, Hash>::ConstIterator::operator++()
 {
-	//проверка дали излизаме извън рамките на data
-	if (currElementIter == data.cend())
-		return *this;
-
-	++currElementIter;
+	position = set->nextLive(position);
 	return *this;
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key,Hash>::ConstIterator InsertionOrderedSet<Key, Hash>::ConstIterator::operator++(int)
 {
-	//проверка дали излизаме извън рамките на data
-	if (currElementIter == data.cend())
-		return *this;
-
 	InsertionOrderedSet<Key, Hash>::ConstIterator temp = *this;
 	++(*this);
 	return temp;
@@ -304,20 +942,14 @@ typename InsertionOrderedSet<Key,Hash>::ConstIterator InsertionOrderedSet<Key, H
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::ConstIterator& InsertionOrderedSet<Key, Hash>::ConstIterator::operator--()
 {
-	//проверка дали излизаме извън рамките на data
-	if (currElementIter == data.cbegin())
-		return *this;
-
-	--currElementIter;
+	//при първия елемент итераторът остава на място
+	position = set->prevLive(position);
 	return *this;
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::ConstIterator InsertionOrderedSet<Key, Hash>::ConstIterator::operator--(int)
 {
-	if (currElementIter == data.cbegin())
-		return *this;
-
 	InsertionOrderedSet<Key, Hash>::ConstIterator temp = *this;
 	--(*this);
 	return temp;
@@ -326,125 +958,115 @@ typename InsertionOrderedSet<Key, Hash>::ConstIterator InsertionOrderedSet<Key,
 template<typename Key, typename Hash>
 const Key* InsertionOrderedSet<Key, Hash>::ConstIterator::operator->() const
 {
-	return &(*currElementIter);
+	return &set->entries[position].key;
 }
 
 template<typename Key, typename Hash>
 bool InsertionOrderedSet<Key, Hash>::ConstIterator::operator==(const ConstIterator& other) const
 {
-	return this->currElementIter == other.currElementIter;
+	return this->position == other.position;
 }
 
 template<typename Key, typename Hash>
 bool InsertionOrderedSet<Key, Hash>::ConstIterator::operator!=(const ConstIterator& other) const
 {
-	return !(this->currElementIter == other.currElementIter);
+	return !(*this == other);
 }
 
 template<typename Key, typename Hash>
 const Key* InsertionOrderedSet<Key, Hash>::Iterator::operator->() const
 {
-	return &(*currElementIter);
+	return &set->entries[position].key;
 }
 
 template<typename Key, typename Hash>
 Key* InsertionOrderedSet<Key, Hash>::Iterator::operator->()
 {
-	return &(*currElementIter);
+	return &set->entries[position].key;
 }
 
 template<typename Key, typename Hash>
 bool InsertionOrderedSet<Key, Hash>::Iterator::operator==(const Iterator& other) const
 {
-	return this->currElementIter == other.currElementIter;
+	return this->position == other.position;
 }
 
 template<typename Key, typename Hash>
 bool InsertionOrderedSet<Key, Hash>::Iterator::operator!=(const Iterator& other) const
 {
-	return !(this->currElementIter == other.currElementIter);;
+	return !(*this == other);
 }
 
 template<typename Key, typename Hash>
 Key& InsertionOrderedSet<Key, Hash>::Iterator::operator*() const
 {
-	return *currElementIter;
+	return set->entries[position].key;
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::Iterator InsertionOrderedSet<Key, Hash>::Iterator::operator+(int off) const
 {
-	//проверка дали излизаме извън рамките на data
-	ConstIterator res = *this;
+	Iterator res = *this;
 
-	while (off > 0) {
-		++res.currElementIter;
-		--off;
-	}
-	while (off < 0) {
-		--res.currElementIter;
-		++off;
+	//без дървото се върви по един жив запис наведнъж
+	if (!set->ranked)
+	{
+		while (off > 0) {
+			++res;
+			--off;
+		}
+		while (off < 0) {
+			--res;
+			++off;
+		}
+
+		return res;
 	}
 
+	//както при ++ и --, извън границите се спира на begin() или end()
+	size_t rank = set->rankOf(position);
+	if (off < 0)
+		rank -= std::min(rank, static_cast<size_t>(-static_cast<long long>(off)));
+	else
+		rank += static_cast<size_t>(off);
+
+	res.position = rank < set->liveCount ? set->positionOfRank(rank) : set->entries.size();
 	return res;
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::Iterator InsertionOrderedSet<Key, Hash>::Iterator::operator-(int off) const
 {
-	ConstIterator res = *this;
-	while (off > 0) {
-		--res.currElementIter;
-		++off;
-	}
-	while (off < 0) {
-		++res.currElementIter;
-		--off;
-	}
-
-	return res;
+	return *this + (-off);
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::Iterator& InsertionOrderedSet<Key, Hash>::Iterator::operator--()
 {
-	if (currElementIter == data.begin())
-		return *this;
-
-	--currElementIter;
+	position = set->prevLive(position);
 	return *this;
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::Iterator InsertionOrderedSet<Key, Hash>::Iterator::operator--(int)
 {
-	if (currElementIter == data.begin())
-		return *this;
-
 	InsertionOrderedSet<Key, Hash>::Iterator temp = *this;
-	++(*this);
+	--(*this);
 	return temp;
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::Iterator& InsertionOrderedSet<Key, Hash>::Iterator::operator++()
 {
-	//проверка дали излизаме извън рамките на data
-	if (currElementIter == data.end())
-		return *this;
-
-	++currElementIter;
+	//при end() итераторът остава на място
+	position = set->nextLive(position);
 	return *this;
 }
 
 template<typename Key, typename Hash>
 typename InsertionOrderedSet<Key, Hash>::Iterator InsertionOrderedSet<Key, Hash>::Iterator::operator++(int)
 {
-	//проверка дали излизаме извън рамките на data
-	if (currElementIter == data.end())
-		return *this;
-
 	InsertionOrderedSet<Key, Hash>::Iterator temp = *this;
 	++(*this);
 	return temp;
-}
\ No newline at end of file
+}
@@ -0,0 +1,386 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//Епохова рекламация на паметта, обща за всички ReadMostlyUnorderedSet.
+//Всяка четяща нишка пише само в собствения си слот, а писачите освобождават
+//обект едва когато всички активни читатели са видели епоха, по-нова с две от тази, в която е бил изваден.
+//Слотовете са в атомарен списък, в който само се добавя - нишка си взима свободен слот с CAS
+//или добавя нов, така че и първото четене в нишката не взима lock.
+class EpochDomain
+{
+private:
+	struct alignas(64) ReaderSlot
+	{
+		std::atomic<uint64_t> epoch{ 0 }; //0 - нишката не чете в момента
+		std::atomic<bool> inUse{ false };
+		ReaderSlot* next = nullptr; //не се променя, след като слотът е в списъка
+	};
+
+	struct RetiredObject
+	{
+		void* ptr;
+		void (*deleter)(void*);
+	};
+
+	class SlotHandle
+	{
+	public:
+		ReaderSlot* slot = nullptr;
+		unsigned depth = 0;
+
+		~SlotHandle()
+		{
+			if (slot)
+				slot->inUse.store(false, std::memory_order_release);
+		}
+	};
+
+	static constexpr unsigned LIMBO_LISTS_COUNT = 3;
+
+	std::atomic<uint64_t> globalEpoch{ 1 };
+	std::mutex mutex; //само за писачите (retire)
+	std::atomic<ReaderSlot*> slots{ nullptr };
+	std::vector<RetiredObject> limbo[LIMBO_LISTS_COUNT];
+
+	EpochDomain() = default;
+
+	ReaderSlot* acquireSlot()
+	{
+		for (ReaderSlot* slot = slots.load(std::memory_order_acquire); slot; slot = slot->next)
+		{
+			bool expected = false;
+			if (!slot->inUse.load(std::memory_order_relaxed) && slot->inUse.compare_exchange_strong(expected, true))
+				return slot;
+		}
+
+		ReaderSlot* slot = new ReaderSlot();
+		slot->inUse.store(true, std::memory_order_relaxed);
+		slot->next = slots.load(std::memory_order_relaxed);
+		while (!slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+		return slot;
+	}
+
+	static SlotHandle& localHandle()
+	{
+		thread_local SlotHandle handle;
+		return handle;
+	}
+
+	static void freeList(std::vector<RetiredObject>& list)
+	{
+		for (const RetiredObject& obj : list)
+			obj.deleter(obj.ptr);
+		list.clear();
+	}
+
+	//Вика се с взет mutex
+	void tryAdvance()
+	{
+		uint64_t epoch = globalEpoch.load(std::memory_order_relaxed);
+		for (const ReaderSlot* slot = slots.load(std::memory_order_acquire); slot; slot = slot->next)
+		{
+			uint64_t readerEpoch = slot->epoch.load(std::memory_order_seq_cst);
+			if (readerEpoch != 0 && readerEpoch != epoch)
+				return;
+		}
+		globalEpoch.store(epoch + 1, std::memory_order_seq_cst);
+		freeList(limbo[(epoch + 1) % LIMBO_LISTS_COUNT]);
+	}
+public:
+	class ReadGuard
+	{
+	private:
+		SlotHandle& handle;
+	public:
+		explicit ReadGuard(EpochDomain& domain) : handle(localHandle())
+		{
+			if (!handle.slot)
+				handle.slot = domain.acquireSlot();
+
+			if (handle.depth++ == 0)
+			{
+				handle.slot->epoch.store(domain.globalEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+			}
+		}
+
+		~ReadGuard()
+		{
+			if (--handle.depth == 0)
+				handle.slot->epoch.store(0, std::memory_order_release);
+		}
+
+		ReadGuard(const ReadGuard& other) = delete;
+		ReadGuard& operator=(const ReadGuard& other) = delete;
+	};
+
+	EpochDomain(const EpochDomain& other) = delete;
+	EpochDomain& operator=(const EpochDomain& other) = delete;
+
+	~EpochDomain()
+	{
+		for (auto& list : limbo)
+			freeList(list);
+
+		ReaderSlot* slot = slots.load(std::memory_order_acquire);
+		while (slot)
+		{
+			ReaderSlot* next = slot->next;
+			delete slot;
+			slot = next;
+		}
+	}
+
+	static EpochDomain& instance()
+	{
+		static EpochDomain domain;
+		return domain;
+	}
+
+	template<typename T>
+	void retire(T* ptr)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		uint64_t epoch = globalEpoch.load(std::memory_order_relaxed);
+		limbo[epoch % LIMBO_LISTS_COUNT].push_back({ ptr, [](void* p) { delete static_cast<T*>(p); } });
+		tryAdvance();
+	}
+};
+
+//Множество за много четения и редки промени. Читателите не взимат lock и не чакат:
+//find/contains обхождат една верига с брой стъпки, ограничен от дължината ѝ.
+//Писачите се сериализират помежду си и публикуват нови възли или цяла нова таблица с атомарна смяна на указател.
+template<typename Key, typename Hash = std::hash<Key>>
+class ReadMostlyUnorderedSet
+{
+private:
+	struct Node
+	{
+		const Key key;
+		std::atomic<Node*> next;
+
+		Node(const Key& _key, Node* _next) : key(_key), next(_next) {}
+	};
+
+	struct Table
+	{
+		size_t bucketsCount;
+		std::unique_ptr<std::atomic<Node*>[]> buckets;
+
+		explicit Table(size_t count);
+		~Table();
+	};
+
+	std::atomic<Table*> table;
+	std::atomic<size_t> elementsCount{ 0 };
+	double maxLoadFactor = 0.75;
+	Hash getHash;
+	std::mutex writersMutex;
+
+	static EpochDomain& domain();
+
+	void resize(); //вика се с взет writersMutex
+	const Node* findNode(const Table* currTable, const Key& key) const;
+public:
+	ReadMostlyUnorderedSet();
+	~ReadMostlyUnorderedSet();
+
+	ReadMostlyUnorderedSet(const ReadMostlyUnorderedSet& other) = delete;
+	ReadMostlyUnorderedSet& operator=(const ReadMostlyUnorderedSet& other) = delete;
+
+	bool insert(const Key& key);
+	bool remove(const Key& key);
+	void clear();
+
+	bool contains(const Key& key) const;
+
+	//func се извиква вътре в критичната секция на читателя - референцията към ключа не бива да се пази след това.
+	template<typename Function>
+	bool find(const Key& key, const Function& func) const;
+
+	template<typename Function>
+	void for_each(const Function& func) const;
+
+	size_t size() const;
+	bool empty() const;
+	double loadFactor() const;
+};
+
+template<typename Key, typename Hash>
+ReadMostlyUnorderedSet<Key, Hash>::Table::Table(size_t count) : bucketsCount(count), buckets(new std::atomic<Node*>[count])
+{
+	for (size_t i = 0; i < bucketsCount; i++)
+		buckets[i].store(nullptr, std::memory_order_relaxed);
+}
+
+template<typename Key, typename Hash>
+ReadMostlyUnorderedSet<Key, Hash>::Table::~Table()
+{
+	for (size_t i = 0; i < bucketsCount; i++)
+	{
+		Node* curr = buckets[i].load(std::memory_order_relaxed);
+		while (curr)
+		{
+			Node* next = curr->next.load(std::memory_order_relaxed);
+			delete curr;
+			curr = next;
+		}
+	}
+}
+
+template<typename Key, typename Hash>
+EpochDomain& ReadMostlyUnorderedSet<Key, Hash>::domain()
+{
+	return EpochDomain::instance();
+}
+
+template<typename Key, typename Hash>
+void ReadMostlyUnorderedSet<Key, Hash>::resize()
+{
+	Table* oldTable = table.load(std::memory_order_relaxed);
+	Table* newTable = new Table(oldTable->bucketsCount * 2);
+
+	//старите възли остават непокътнати, докато читателите още може да ги обхождат
+	for (size_t i = 0; i < oldTable->bucketsCount; i++)
+	{
+		for (Node* curr = oldTable->buckets[i].load(std::memory_order_relaxed); curr; curr = curr->next.load(std::memory_order_relaxed))
+		{
+			auto& bucket = newTable->buckets[getHash(curr->key) % newTable->bucketsCount];
+			bucket.store(new Node(curr->key, bucket.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+		}
+	}
+
+	table.store(newTable, std::memory_order_release);
+	domain().retire(oldTable);
+}
+
+template<typename Key, typename Hash>
+const typename ReadMostlyUnorderedSet<Key, Hash>::Node* ReadMostlyUnorderedSet<Key, Hash>::findNode(const Table* currTable, const Key& key) const
+{
+	size_t hashCode = getHash(key) % currTable->bucketsCount;
+	for (const Node* curr = currTable->buckets[hashCode].load(std::memory_order_acquire); curr; curr = curr->next.load(std::memory_order_acquire))
+	{
+		if (curr->key == key)
+			return curr;
+	}
+	return nullptr;
+}
+
+template<typename Key, typename Hash>
+ReadMostlyUnorderedSet<Key, Hash>::ReadMostlyUnorderedSet() : table(new Table(8))
+{
+	domain();
+}
+
+template<typename Key, typename Hash>
+ReadMostlyUnorderedSet<Key, Hash>::~ReadMostlyUnorderedSet()
+{
+	delete table.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Hash>
+bool ReadMostlyUnorderedSet<Key, Hash>::insert(const Key& key)
+{
+	std::lock_guard<std::mutex> lock(writersMutex);
+	if (findNode(table.load(std::memory_order_relaxed), key))
+		return false;
+
+	if (static_cast<double>(elementsCount.load(std::memory_order_relaxed) + 1) / table.load(std::memory_order_relaxed)->bucketsCount > maxLoadFactor)
+		resize();
+
+	Table* currTable = table.load(std::memory_order_relaxed);
+	auto& bucket = currTable->buckets[getHash(key) % currTable->bucketsCount];
+	bucket.store(new Node(key, bucket.load(std::memory_order_relaxed)), std::memory_order_release);
+	elementsCount.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+template<typename Key, typename Hash>
+bool ReadMostlyUnorderedSet<Key, Hash>::remove(const Key& key)
+{
+	std::lock_guard<std::mutex> lock(writersMutex);
+	Table* currTable = table.load(std::memory_order_relaxed);
+
+	std::atomic<Node*>* link = &currTable->buckets[getHash(key) % currTable->bucketsCount];
+	for (Node* curr = link->load(std::memory_order_relaxed); curr; curr = link->load(std::memory_order_relaxed))
+	{
+		if (curr->key == key)
+		{
+			//curr->next не се променя, така че читател, стигнал до curr, продължава по веригата
+			link->store(curr->next.load(std::memory_order_relaxed), std::memory_order_release);
+			elementsCount.fetch_sub(1, std::memory_order_relaxed);
+			domain().retire(curr);
+			return true;
+		}
+		link = &curr->next;
+	}
+	return false;
+}
+
+template<typename Key, typename Hash>
+void ReadMostlyUnorderedSet<Key, Hash>::clear()
+{
+	std::lock_guard<std::mutex> lock(writersMutex);
+	Table* oldTable = table.exchange(new Table(8), std::memory_order_acq_rel);
+	elementsCount.store(0, std::memory_order_relaxed);
+	domain().retire(oldTable);
+}
+
+template<typename Key, typename Hash>
+bool ReadMostlyUnorderedSet<Key, Hash>::contains(const Key& key) const
+{
+	EpochDomain::ReadGuard guard(domain());
+	return findNode(table.load(std::memory_order_acquire), key) != nullptr;
+}
+
+template<typename Key, typename Hash>
+template<typename Function>
+bool ReadMostlyUnorderedSet<Key, Hash>::find(const Key& key, const Function& func) const
+{
+	EpochDomain::ReadGuard guard(domain());
+	const Node* node = findNode(table.load(std::memory_order_acquire), key);
+	if (!node)
+		return false;
+
+	func(node->key);
+	return true;
+}
+
+template<typename Key, typename Hash>
+template<typename Function>
+void ReadMostlyUnorderedSet<Key, Hash>::for_each(const Function& func) const
+{
+	EpochDomain::ReadGuard guard(domain());
+	const Table* currTable = table.load(std::memory_order_acquire);
+	for (size_t i = 0; i < currTable->bucketsCount; i++)
+	{
+		for (const Node* curr = currTable->buckets[i].load(std::memory_order_acquire); curr; curr = curr->next.load(std::memory_order_acquire))
+			func(curr->key);
+	}
+}
+
+template<typename Key, typename Hash>
+size_t ReadMostlyUnorderedSet<Key, Hash>::size() const
+{
+	return elementsCount.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Hash>
+bool ReadMostlyUnorderedSet<Key, Hash>::empty() const
+{
+	return size() == 0;
+}
+
+template<typename Key, typename Hash>
+double ReadMostlyUnorderedSet<Key, Hash>::loadFactor() const
+{
+	EpochDomain::ReadGuard guard(domain());
+	return static_cast<double>(size()) / table.load(std::memory_order_acquire)->bucketsCount;
+}
@@ -0,0 +1,255 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+namespace StaticSetHashing
+{
+	constexpr uint64_t mix(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	template<typename Key>
+	constexpr uint64_t hash(const Key& key, uint64_t seed)
+	{
+		if constexpr (std::is_enum<Key>::value)
+			return mix(static_cast<uint64_t>(static_cast<std::underlying_type_t<Key>>(key)) ^ seed);
+		else
+			return mix(static_cast<uint64_t>(key) ^ seed);
+	}
+
+	//FNV-1a, последвано от mix, защото старшите битове на FNV се разбъркват слабо
+	constexpr uint64_t hash(std::string_view key, uint64_t seed)
+	{
+		uint64_t h = 0xcbf29ce484222325ULL;
+		for (char c : key)
+		{
+			h ^= static_cast<unsigned char>(c);
+			h *= 0x100000001b3ULL;
+		}
+		return mix(h ^ seed);
+	}
+}
+
+//Множество от фиксиран списък ключове (цели числа, enum-и или string_view), построено изцяло по време на компилация.
+//Перфектният хеш е като във FrozenUnorderedSet (CHD): ключовете се делят на групи по около 4 и за всяка група
+//се търси отместване, при което ключовете ѝ попадат в празни слотове. Слотовете са поне 2 * N, за да е търсенето кратко.
+//Ключовете и таблиците са членове на обекта, така че constexpr променлива отива в read-only данните.
+template<typename Key, size_t N>
+class StaticUnorderedSet
+{
+	static_assert(std::is_integral<Key>::value || std::is_enum<Key>::value || std::is_same<Key, std::string_view>::value,
+		"StaticUnorderedSet keys must be integers, enums or std::string_view");
+	static_assert(N > 0 && N < UINT32_MAX, "StaticUnorderedSet needs between 1 and 2^32 - 1 keys");
+private:
+	static constexpr size_t roundUpPowerOfTwo(size_t count)
+	{
+		size_t result = 1;
+		while (result < count)
+			result *= 2;
+		return result;
+	}
+
+	static constexpr size_t SLOTS_COUNT = roundUpPowerOfTwo(N * 2);
+	static constexpr size_t GROUPS_COUNT = roundUpPowerOfTwo((N + 3) / 4);
+	static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+	static constexpr uint32_t MAX_DISPLACEMENT = 1u << 12;
+	static constexpr uint64_t DISPLACEMENT_STEP = 0x9E3779B97F4A7C15ULL;
+
+	Key keys[N] = {};
+	uint32_t slots[SLOTS_COUNT] = {}; //индекс в keys или EMPTY_SLOT
+	uint32_t displacements[GROUPS_COUNT] = {};
+	uint64_t seed = 0;
+
+	static constexpr size_t groupFor(uint64_t hash)
+	{
+		return static_cast<size_t>(hash >> 40) & (GROUPS_COUNT - 1);
+	}
+
+	static constexpr size_t slotFor(uint64_t hash, uint32_t displacement)
+	{
+		return static_cast<size_t>(StaticSetHashing::mix(hash + displacement * DISPLACEMENT_STEP)) & (SLOTS_COUNT - 1);
+	}
+
+	//Опитва да подреди ключовете с даденото зърно. Връща false, ако някоя група не може да се настани.
+	constexpr bool tryPlace(uint64_t currSeed);
+public:
+	//Повтарящ се ключ прави израза неконстантен, т.е. води до грешка при компилация
+	constexpr explicit StaticUnorderedSet(const Key (&input)[N]);
+
+	constexpr const Key* find(const Key& key) const;
+	constexpr bool contains(const Key& key) const;
+	constexpr size_t count(const Key& key) const;
+
+	constexpr const Key* begin() const;
+	constexpr const Key* end() const;
+	constexpr const Key* cbegin() const;
+	constexpr const Key* cend() const;
+
+	constexpr size_t size() const;
+	constexpr bool empty() const;
+};
+
+template<typename Key, size_t N>
+constexpr bool StaticUnorderedSet<Key, N>::tryPlace(uint64_t currSeed)
+{
+	uint64_t hashes[N] = {};
+	size_t groupStart[GROUPS_COUNT + 1] = {};
+	size_t order[N] = {};
+	size_t candidate[N] = {};
+
+	for (size_t i = 0; i < N; i++)
+	{
+		hashes[i] = StaticSetHashing::hash(keys[i], currSeed);
+		groupStart[groupFor(hashes[i]) + 1]++;
+	}
+
+	size_t maxGroupSize = 0;
+	for (size_t g = 0; g < GROUPS_COUNT; g++)
+	{
+		if (groupStart[g + 1] > maxGroupSize)
+			maxGroupSize = groupStart[g + 1];
+		groupStart[g + 1] += groupStart[g];
+	}
+
+	size_t nextPos[GROUPS_COUNT] = {};
+	for (size_t g = 0; g < GROUPS_COUNT; g++)
+		nextPos[g] = groupStart[g];
+	for (size_t i = 0; i < N; i++)
+		order[nextPos[groupFor(hashes[i])]++] = i;
+
+	for (size_t s = 0; s < SLOTS_COUNT; s++)
+		slots[s] = EMPTY_SLOT;
+
+	//първо най-големите групи, докато таблицата е празна
+	for (size_t groupSize = maxGroupSize; groupSize > 0; groupSize--)
+	{
+		for (size_t g = 0; g < GROUPS_COUNT; g++)
+		{
+			size_t from = groupStart[g], to = groupStart[g + 1];
+			if (to - from != groupSize)
+				continue;
+
+			bool placed = false;
+			for (uint32_t displacement = 0; displacement < MAX_DISPLACEMENT && !placed; displacement++)
+			{
+				placed = true;
+				for (size_t j = from; j < to && placed; j++)
+				{
+					candidate[j] = slotFor(hashes[order[j]], displacement);
+					placed = slots[candidate[j]] == EMPTY_SLOT;
+					for (size_t k = from; k < j && placed; k++)
+						placed = candidate[k] != candidate[j];
+				}
+
+				if (placed)
+					displacements[g] = displacement;
+			}
+
+			if (!placed)
+				return false;
+
+			for (size_t j = from; j < to; j++)
+				slots[candidate[j]] = static_cast<uint32_t>(order[j]);
+		}
+	}
+	return true;
+}
+
+template<typename Key, size_t N>
+constexpr StaticUnorderedSet<Key, N>::StaticUnorderedSet(const Key (&input)[N])
+{
+	for (size_t i = 0; i < N; i++)
+	{
+		keys[i] = input[i];
+		for (size_t j = 0; j < i; j++)
+		{
+			if (keys[j] == keys[i])
+				throw std::invalid_argument("Duplicate key in StaticUnorderedSet");
+		}
+	}
+
+	seed = 0x243F6A8885A308D3ULL;
+	while (!tryPlace(seed))
+		seed = StaticSetHashing::mix(seed + 1);
+}
+
+template<typename Key, size_t N>
+constexpr const Key* StaticUnorderedSet<Key, N>::find(const Key& key) const
+{
+	uint64_t hash = StaticSetHashing::hash(key, seed);
+	uint32_t index = slots[slotFor(hash, displacements[groupFor(hash)])];
+	if (index != EMPTY_SLOT && keys[index] == key)
+		return keys + index;
+
+	return end();
+}
+
+template<typename Key, size_t N>
+constexpr bool StaticUnorderedSet<Key, N>::contains(const Key& key) const
+{
+	return find(key) != end();
+}
+
+template<typename Key, size_t N>
+constexpr size_t StaticUnorderedSet<Key, N>::count(const Key& key) const
+{
+	return contains(key) ? 1 : 0;
+}
+
+template<typename Key, size_t N>
+constexpr const Key* StaticUnorderedSet<Key, N>::begin() const
+{
+	return keys;
+}
+
+template<typename Key, size_t N>
+constexpr const Key* StaticUnorderedSet<Key, N>::end() const
+{
+	return keys + N;
+}
+
+template<typename Key, size_t N>
+constexpr const Key* StaticUnorderedSet<Key, N>::cbegin() const
+{
+	return begin();
+}
+
+template<typename Key, size_t N>
+constexpr const Key* StaticUnorderedSet<Key, N>::cend() const
+{
+	return end();
+}
+
+template<typename Key, size_t N>
+constexpr size_t StaticUnorderedSet<Key, N>::size() const
+{
+	return N;
+}
+
+template<typename Key, size_t N>
+constexpr bool StaticUnorderedSet<Key, N>::empty() const
+{
+	return false;
+}
+
+//make_static_set({1, 2, 3}) или make_static_set({"if", "else"}). Низовите литерали стават string_view.
+template<typename Key, size_t N, typename = std::enable_if_t<std::is_integral<Key>::value || std::is_enum<Key>::value || std::is_same<Key, std::string_view>::value>>
+constexpr StaticUnorderedSet<Key, N> make_static_set(const Key (&keys)[N])
+{
+	return StaticUnorderedSet<Key, N>(keys);
+}
+
+template<size_t N>
+constexpr StaticUnorderedSet<std::string_view, N> make_static_set(const std::string_view (&keys)[N])
+{
+	return StaticUnorderedSet<std::string_view, N>(keys);
+}
@@ -0,0 +1,364 @@
+﻿#pragma once
+#include <stdexcept>
+#include <utility>
+#include "UnorderedSet.hpp"
+
+//Двойка ключ-стойност - елементът на UnorderedMap. Ключът е const, както в std::pair<const Key, T>,
+//защото промяната му през итератор би оставила двойката в чужд бъкет.
+template<typename Key, typename Value>
+struct MapEntry
+{
+	const Key first;
+	Value second;
+
+	template<typename K, typename... Args>
+	MapEntry(in_place_t, K&& key, Args&&... args) : first(forward<K>(key)), second(forward<Args>(args)...) {}
+};
+
+template<typename Key, typename Value>
+struct CacheHashCode<MapEntry<Key, Value>> : CacheHashCode<Key> {};
+
+//Наредба само по ключа. С нея UnorderedSet преобразува дългите вериги на речника (treeify) както за голи ключове.
+template<typename Key, typename Value, typename = enable_if_t<IsLessComparable<Key, Key>::value>>
+bool operator<(const MapEntry<Key, Value>& lhs, const MapEntry<Key, Value>& rhs)
+{
+	return less<Key>()(lhs.first, rhs.first);
+}
+
+template<typename Key, typename Value, typename = enable_if_t<IsLessComparable<Key, Key>::value>>
+bool operator<(const MapEntry<Key, Value>& entry, const Key& key)
+{
+	return less<Key>()(entry.first, key);
+}
+
+template<typename Key, typename Value, typename = enable_if_t<IsLessComparable<Key, Key>::value>>
+bool operator<(const Key& key, const MapEntry<Key, Value>& entry)
+{
+	return less<Key>()(key, entry.first);
+}
+
+template<typename Key, typename Value>
+struct KeyHeapUsage<MapEntry<Key, Value>>
+{
+	static constexpr bool OWNS_HEAP = KeyHeapUsage<Key>::OWNS_HEAP || KeyHeapUsage<Value>::OWNS_HEAP;
+
+	static size_t bytes(const MapEntry<Key, Value>& entry)
+	{
+		return KeyHeapUsage<Key>::bytes(entry.first) + KeyHeapUsage<Value>::bytes(entry.second);
+	}
+};
+
+//Хешира двойката само по ключа. Прозрачен е, за да може UnorderedSet да търси двойка по голия ключ.
+template<typename Key, typename Value, typename Hash>
+struct MapEntryHash
+{
+	using is_transparent = void;
+	Hash getHash;
+
+	size_t operator()(const MapEntry<Key, Value>& entry) const
+	{
+		return getHash(entry.first);
+	}
+
+	template<typename K>
+	size_t operator()(const K& key) const
+	{
+		return getHash(key);
+	}
+};
+
+template<typename Key, typename Value, typename KeyEqual>
+struct MapEntryEqual
+{
+	using is_transparent = void;
+	KeyEqual keyEqual;
+
+	bool operator()(const MapEntry<Key, Value>& lhs, const MapEntry<Key, Value>& rhs) const
+	{
+		return keyEqual(lhs.first, rhs.first);
+	}
+
+	template<typename K>
+	bool operator()(const MapEntry<Key, Value>& entry, const K& key) const
+	{
+		return keyEqual(entry.first, key);
+	}
+};
+
+template<typename Key, typename Value, typename KeyEqual>
+struct OrderMatchesEquality<MapEntry<Key, Value>, MapEntryEqual<Key, Value, KeyEqual>> : OrderMatchesEquality<Key, KeyEqual> {};
+
+//Речник върху UnorderedSet: възлите на множеството пазят двойки, а хешът и сравнението гледат само ключа.
+//Така едно търсене дава и наличието, и стойността. Бъкетите, преоразмеряването и итераторите са тези на UnorderedSet.
+template<typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>, typename BucketPolicy = PowerOfTwoBucketPolicy>
+class UnorderedMap
+{
+public:
+	using Entry = MapEntry<Key, Value>;
+	using Set = UnorderedSet<Entry, MapEntryHash<Key, Value, Hash>, MapEntryEqual<Key, Value, KeyEqual>, BucketPolicy>;
+	using Iterator = typename Set::Iterator;
+	using ConstIterator = typename Set::ConstIterator;
+private:
+	Set entries;
+
+	//Хетерогенните версии се включват само ако и Hash, и KeyEqual са прозрачни
+	template<typename K>
+	using EnableIfTransparent = enable_if_t<IsTransparent<Hash>::value && IsTransparent<KeyEqual>::value
+		&& !is_convertible<const K&, ConstIterator>::value>;
+public:
+	//Стойността се конструира от args само ако key липсва
+	template<typename... Args>
+	pair<Iterator, bool> try_emplace(const Key& key, Args&&... args);
+	template<typename... Args>
+	pair<Iterator, bool> try_emplace(Key&& key, Args&&... args);
+
+	template<typename V>
+	pair<Iterator, bool> insert_or_assign(const Key& key, V&& value);
+	template<typename V>
+	pair<Iterator, bool> insert_or_assign(Key&& key, V&& value);
+
+	Value& operator[](const Key& key);
+	Value& operator[](Key&& key);
+
+	Value& at(const Key& key);
+	const Value& at(const Key& key) const;
+
+	Iterator find(const Key& key);
+	ConstIterator find(const Key& key) const;
+	bool contains(const Key& key) const;
+	size_t count(const Key& key) const;
+	void remove(const Key& key);
+
+	template<typename K, typename = EnableIfTransparent<K>>
+	Iterator find(const K& key);
+
+	template<typename K, typename = EnableIfTransparent<K>>
+	ConstIterator find(const K& key) const;
+
+	template<typename K, typename = EnableIfTransparent<K>>
+	bool contains(const K& key) const;
+
+	template<typename K, typename = EnableIfTransparent<K>>
+	size_t count(const K& key) const;
+
+	template<typename K, typename = EnableIfTransparent<K>>
+	void remove(const K& key);
+
+	//pred(const Entry&). Връща броя изтрити двойки.
+	template<typename Predicate>
+	size_t erase_if(const Predicate& pred);
+
+	//func(const Entry&)
+	template<typename Function>
+	void for_each(const Function& func) const;
+
+	Iterator begin();
+	Iterator end();
+	ConstIterator cbegin() const;
+	ConstIterator cend() const;
+
+	void clear();
+	void reserve(size_t elements);
+	bool empty() const;
+	size_t size() const;
+
+	size_t memory_usage() const;
+};
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename... Args>
+pair<typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::Iterator, bool> UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::try_emplace(const Key& key, Args&&... args)
+{
+	return entries.try_emplace(key, in_place, key, forward<Args>(args)...);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename... Args>
+pair<typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::Iterator, bool> UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::try_emplace(Key&& key, Args&&... args)
+{
+	//ключът се мести едва след търсенето, и то само ако липсва
+	return entries.try_emplace(key, in_place, move(key), forward<Args>(args)...);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename V>
+pair<typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::Iterator, bool> UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::insert_or_assign(const Key& key, V&& value)
+{
+	auto result = entries.try_emplace(key, in_place, key, forward<V>(value));
+	if (!result.second)
+		result.first->second = forward<V>(value);
+	return result;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename V>
+pair<typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::Iterator, bool> UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::insert_or_assign(Key&& key, V&& value)
+{
+	auto result = entries.try_emplace(key, in_place, move(key), forward<V>(value));
+	if (!result.second)
+		result.first->second = forward<V>(value);
+	return result;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+Value& UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::operator[](const Key& key)
+{
+	return try_emplace(key).first->second;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+Value& UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::operator[](Key&& key)
+{
+	return try_emplace(move(key)).first->second;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+Value& UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::at(const Key& key)
+{
+	Iterator it = find(key);
+	if (it == end())
+		throw out_of_range("Key is not in the map");
+	return it->second;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+const Value& UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::at(const Key& key) const
+{
+	ConstIterator it = find(key);
+	if (it == cend())
+		throw out_of_range("Key is not in the map");
+	return it->second;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::find(const Key& key)
+{
+	return entries.findMutable(key);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::find(const Key& key) const
+{
+	return entries.find(key);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+bool UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::contains(const Key& key) const
+{
+	return entries.contains(key);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+size_t UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::count(const Key& key) const
+{
+	return entries.count(key);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::remove(const Key& key)
+{
+	entries.remove(key);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename>
+typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::find(const K& key)
+{
+	return entries.findMutable(key);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename>
+typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::find(const K& key) const
+{
+	return entries.find(key);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename>
+bool UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::contains(const K& key) const
+{
+	return entries.contains(key);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename>
+size_t UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::count(const K& key) const
+{
+	return entries.count(key);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename>
+void UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::remove(const K& key)
+{
+	entries.remove(key);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Predicate>
+size_t UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::erase_if(const Predicate& pred)
+{
+	return entries.erase_if(pred);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Function>
+void UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::for_each(const Function& func) const
+{
+	entries.for_each(func);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::begin()
+{
+	return entries.begin();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::end()
+{
+	return entries.end();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::cbegin() const
+{
+	return entries.cbegin();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::cend() const
+{
+	return entries.cend();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::clear()
+{
+	entries.clearSet();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::reserve(size_t elements)
+{
+	entries.reserve(elements);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+bool UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::empty() const
+{
+	return entries.empty();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+size_t UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::size() const
+{
+	return entries.size();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+size_t UnorderedMap<Key, Value, Hash, KeyEqual, BucketPolicy>::memory_usage() const
+{
+	return entries.memory_usage();
+}
@@ -1,42 +1,240 @@
 ﻿#pragma once
 #include <vector>
 #include <forward_list>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <cmath>
+#include <memory>
+#include <random>
+#include "BucketPolicy.hpp"
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
 
 using namespace std;
-template<typename Key, typename Hash = std::hash<Key>>
+
+inline void prefetchForRead(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(address, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#endif
+}
+
+template<typename T, typename = void>
+struct IsTransparent : false_type {};
+
+template<typename T>
+struct IsTransparent<T, void_t<typename T::is_transparent>> : true_type {};
+
+//Хешира string, string_view и const char* еднакво, без да създава временен string
+struct TransparentStringHash
+{
+	using is_transparent = void;
+
+	size_t operator()(string_view str) const
+	{
+		return hash<string_view>()(str);
+	}
+};
+
+template<typename T, typename U, typename = void>
+struct IsLessComparable : false_type {};
+
+template<typename T, typename U>
+struct IsLessComparable<T, U, void_t<decltype(declval<const T&>() < declval<const U&>()), decltype(declval<const U&>() < declval<const T&>())>> : true_type {};
+
+//Дали наредбата с operator< съвпада с равенството на KeyEqual. Обвиващи типове (като MapEntry) я специализират.
+template<typename Key, typename KeyEqual>
+struct OrderMatchesEquality : bool_constant<is_same<KeyEqual, equal_to<Key>>::value || is_same<KeyEqual, equal_to<>>::value> {};
+
+//Дали възлите да пазят пълния хеш до ключа. Тогава resize не хешира ключовете наново,
+//а при търсене ключовете се сравняват само ако хешовете съвпадат. Може да се специализира за други типове.
+template<typename Key>
+struct CacheHashCode : false_type {};
+
+template<typename CharT, typename Traits, typename Allocator>
+struct CacheHashCode<basic_string<CharT, Traits, Allocator>> : true_type {};
+
+//Колко байта динамична памет държи ключът извън себе си - за memory_usage(). Може да се специализира за други типове.
+template<typename Key>
+struct KeyHeapUsage
+{
+	static constexpr bool OWNS_HEAP = false;
+	static size_t bytes(const Key&) { return 0; }
+};
+
+template<typename CharT, typename Traits, typename Allocator>
+struct KeyHeapUsage<basic_string<CharT, Traits, Allocator>>
+{
+	static constexpr bool OWNS_HEAP = true;
+
+	static size_t bytes(const basic_string<CharT, Traits, Allocator>& str)
+	{
+		//при short string optimization символите са в самия обект
+		const char* data = reinterpret_cast<const char*>(str.data());
+		const char* object = reinterpret_cast<const char*>(&str);
+		if (data >= object && data < object + sizeof(str))
+			return 0;
+
+		return (str.capacity() + 1) * sizeof(CharT);
+	}
+};
+
+template<typename Key, bool CacheHash = CacheHashCode<Key>::value>
+struct HashNode
+{
+	Key key;
+
+	template<typename... Args>
+	explicit HashNode(in_place_t, Args&&... args) : key(forward<Args>(args)...) {}
+
+	void setHash(size_t) {}
+};
+
+template<typename Key>
+struct HashNode<Key, true>
+{
+	Key key;
+	size_t hash = 0;
+
+	template<typename... Args>
+	explicit HashNode(in_place_t, Args&&... args) : key(forward<Args>(args)...) {}
+
+	void setHash(size_t _hash) { hash = _hash; }
+};
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual, typename BucketPolicy>
+class UnorderedMap;
+
+template<typename Key, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>, typename BucketPolicy = PowerOfTwoBucketPolicy>
 class UnorderedSet
 {
 private:
-	vector<forward_list<Key>> hashTable;
+	using Node = HashNode<Key>;
+	using Bucket = forward_list<Node>;
+
+	vector<Bucket> hashTable;
+	size_t elementsCount = 0;
+	size_t firstNonEmptyBucket = 0; //първият непразен бъкет или hashTable.size(). Поддържа се от промените, а не от cbegin.
 	double maxLoadFactor = 0.75;
+	double minLoadFactor = 0; //0 - таблицата не се смалява сама
 	Hash getHash;
+	KeyEqual keyEqual;
+	BucketPolicy bucketPolicy;
+	size_t hashSeed = 0;
+
+	//Бъкет с повече от TREEIFY_THRESHOLD възела се сортира и получава сортиран масив от итератори към възлите си,
+	//така че търсенето в него е O(log) дори при лош или атакуван хеш. Под UNTREEIFY_THRESHOLD масивът се освобождава.
+	//Прилага се само за ключове с operator<, чиято наредба съвпада с равенството (KeyEqual е std::equal_to).
+	static constexpr bool CAN_TREEIFY = IsLessComparable<Key, Key>::value && OrderMatchesEquality<Key, KeyEqual>::value;
+	static constexpr size_t TREEIFY_THRESHOLD = 16;
+	static constexpr size_t UNTREEIFY_THRESHOLD = 8;
+
+	using ChainIndex = vector<typename Bucket::iterator>;
+	vector<unique_ptr<ChainIndex>> chainIndexes; //празен, докато никой бъкет не е преобразуван
+
+	const ChainIndex* getChainIndex(size_t hashCode) const;
+	void treeify(size_t hashCode);
+	void rebuildChainIndexes();
+
+	template<typename K>
+	typename ChainIndex::const_iterator lowerBoundInChain(const ChainIndex& index, const K& key) const;
+
+	typename Bucket::iterator linkNode(size_t hashCode, Bucket& node);
+	void unlinkAfter(size_t hashCode, typename Bucket::iterator prev, Bucket& out); //прехвърля възела след prev в out
+	void eraseAfter(size_t hashCode, typename Bucket::iterator prev);
+	void skipEmptyBuckets(); //мести firstNonEmptyBucket напред до първия непразен бъкет
+
+	void resize(size_t newBucketsCount);
+	size_t getBucketsCountFor(size_t elements) const;
+	bool needsGrowth() const;
+	void shrinkIfSparse(); //вика се след публичните операции, които махат ключове
 
-	void resize();
-	size_t getHashCode(const Key& key) const;
+	size_t getBucketIndex(size_t hash) const;
+	size_t getNodeHash(const Node& node) const;
+
+	template<typename K>
+	bool nodeMatches(const Node& node, size_t hash, const K& key) const;
+
+	template<typename K>
+	typename Bucket::const_iterator findInBucket(size_t hashCode, size_t hash, const K& key) const;
+
+	//Връща възела преди търсения ключ, или последния възел на бъкета, ако ключът липсва
+	template<typename K>
+	typename Bucket::iterator findPrevInBucket(size_t hashCode, size_t hash, const K& key);
+
+	template<typename K>
+	void removeKey(const K& key);
+
+	//Не променя elementsCount, за да може да се вика паралелно за различни диапазони.
+	//erasedCount расте след всеки изтрит възел, така че е точен и ако pred хвърли.
+	template<typename Predicate>
+	void eraseIfInBuckets(const Predicate& pred, size_t from, size_t to, size_t& erasedCount);
+
+	//Ключ i се хешира и бъкетът му се prefetch-ва на стъпка i - 2 * PREFETCH_DISTANCE, а първият му възел - на i - PREFETCH_DISTANCE.
+	//Така главата на бъкета вече е в кеша, когато се чете, и до 2 * PREFETCH_DISTANCE промахвания се чакат едновременно.
+	static constexpr size_t PREFETCH_DISTANCE = 8;
+	static constexpr size_t BATCH_RING_SIZE = 32; //степен на двойката, поне 2 * PREFETCH_DISTANCE + 1
+	static constexpr size_t BATCH_PREFETCH_MIN_BYTES = static_cast<size_t>(4) << 20; //по-малка таблица е в L2 или близо до него и prefetch само забавя
+
+	void prefetchFirstNode(size_t hashCode) const;
+
+	template<typename K, typename Resolver>
+	void probeBatch(const K* keys, size_t count, const Resolver& resolve) const;
+
+	//Изпълнява func(0) .. func(threadsCount - 1) в отделни нишки и хвърля първото възникнало изключение
+	template<typename Function>
+	static void runParallel(unsigned threadsCount, const Function& func);
+
+	//Бъкетите се делят на парчета, а всяка нишка получава последователен диапазон от парчета.
+	//Нишката взима парчета от началото на своя диапазон, а когато свърши - краде половината от края на чужд.
+	//Диапазонът е пакетиран в един atomic<uint64_t> (начало << 32 | край), така че и двете страни го менят с CAS.
+	//Вика func(threadIndex, fromBucket, toBucket) за всяко парче.
+	template<typename Function>
+	void forEachBucketChunk(unsigned threadsCount, const Function& func) const;
+
+	//Общата част на build_parallel - keyAt(i) връща i-тия от count ключа, а seed става hashSeed на резултата
+	template<typename KeyAt>
+	static UnorderedSet buildFromIndexed(size_t count, const KeyAt& keyAt, unsigned threadsCount, size_t seed);
+
+	//Събира указатели към ключовете на source, за които keep(key, hash) е вярно. Бъкетите на source
+	//се разделят на threadsCount последователни диапазона, а резултатите се подреждат по бъкети.
+	template<typename Predicate>
+	static vector<const Key*> collectKeys(const UnorderedSet& source, const Predicate& keep, unsigned threadsCount);
 
-	int getElementsCount() const;
 public:
+	class Iterator;
+
 	class ConstIterator
 	{
 	private:
-		const UnorderedSet<Key, Hash>& set;
+		const UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>* set;
 
-		typename forward_list<Key>::const_iterator currElementIter;
-		int bucketIndex;
-		ConstIterator(const UnorderedSet<Key, Hash>& _set, typename forward_list<Key>::const_iterator curr);
+		size_t bucketIndex; //== hashTable.size() за cend()
+		typename Bucket::const_iterator currElementIter;
+		ConstIterator(const UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>* _set, size_t _bucketIndex, typename Bucket::const_iterator curr);
 		friend class UnorderedSet;
 
-		bool isLastElementInBucket() const;
-		bool isLastElementInHashTable() const;
-		bool isFirstElementInHashTable() const;
-		bool isFirstElementInBucket() const;
-
-		bool emptyBucket(size_t bucketIndex) const;
-		int lastNonEmptyBucketIndex() const;
-
-		bool isLastElement(const Key& key) const;
+		void skipEmptyBuckets();
 	public:
+		ConstIterator(const Iterator& other);
+
 		const Key& operator*() const;
+		const Key* operator->() const;
 
 		ConstIterator operator+(int off) const;
 		ConstIterator operator-(int off) const;
@@ -47,8 +245,6 @@ public:
 		ConstIterator& operator--(); //--it
 		ConstIterator operator--(int); //it--
 
-		//const Key* operator->() const;
-
 		bool operator==(const ConstIterator& other) const;
 		bool operator!=(const ConstIterator& other) const;
 	};
@@ -56,24 +252,18 @@ public:
 	class Iterator 
 	{
 	private:
-		const UnorderedSet<Key, Hash>& set;
+		UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>* set;
 
-		typename forward_list<Key>::iterator currElementIter;
-		size_t bucketIndex;
-		Iterator(const UnorderedSet& set, typename forward_list<Key>::iterator curr);
+		size_t bucketIndex; //== hashTable.size() за end()
+		typename Bucket::iterator currElementIter;
+		Iterator(UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>* _set, size_t _bucketIndex, typename Bucket::iterator curr);
 		friend class UnorderedSet;
+		friend class ConstIterator;
 
-		bool isLastElementInBucket() const;
-		bool isLastElementInHashTable() const;
-		bool isFirstElementInHashTable() const;
-		bool isFirstElementInBucket() const;
-
-		bool emptyBucket(size_t bucketIndex) const;
-		int lastNonEmptyBucketIndex() const;
-
-		bool isLastElement(const Key& key) const;
+		void skipEmptyBuckets();
 	public:
 		Key& operator*() const;
+		Key* operator->() const;
 
 		Iterator operator+(int off) const;
 		Iterator operator-(int off) const;
@@ -84,27 +274,156 @@ public:
 		Iterator& operator++(); //++it
 		Iterator operator++(int); //it++
 
-		//const Key* operator->() const;
-		//Key* operator->();
-
 		bool operator==(const Iterator& other) const;
 		bool operator!=(const Iterator& other) const;
 	};
 
-	UnorderedSet();
+	//Притежава един изваден възел. Ключът може да се промени през value() и възелът да се върне
+	//със insert, без да се заделя нова памет.
+	class NodeHandle
+	{
+	private:
+		Bucket node; //празен или с точно един възел
+		friend class UnorderedSet;
+	public:
+		NodeHandle() = default;
+		NodeHandle(NodeHandle&& other) = default;
+		NodeHandle& operator=(NodeHandle&& other) = default;
+
+		NodeHandle(const NodeHandle& other) = delete;
+		NodeHandle& operator=(const NodeHandle& other) = delete;
 
-	void insert(const Key& key);
+		bool empty() const;
+		explicit operator bool() const;
+
+		Key& value();
+		const Key& value() const;
+	};
+
+private:
+	//Хетерогенните версии се включват само ако и Hash, и KeyEqual са прозрачни
+	template<typename K>
+	using EnableIfTransparent = enable_if_t<IsTransparent<Hash>::value && IsTransparent<KeyEqual>::value
+		&& !is_convertible<const K&, ConstIterator>::value>;
+
+	//try_emplace търси по key: самият Key или, при прозрачни Hash и KeyEqual, друг тип
+	template<typename K>
+	using EnableIfLookupKey = enable_if_t<is_same<K, Key>::value || (IsTransparent<Hash>::value && IsTransparent<KeyEqual>::value)>;
+
+	//UnorderedMap пази двойките в този клас и сменя стойностите през Iterator
+	template<typename, typename, typename, typename, typename>
+	friend class UnorderedMap;
+
+	template<typename K>
+	Iterator findMutable(const K& key);
+
+	pair<Iterator, bool> emplaceNode(Bucket& node); //node съдържа един възел с още неизчислен хеш
+
+	//true, ако ключът ще се построи от самия key: Key(key) както в insert или Key(in_place, key, ...) както MapEntry.
+	//Сравняват се адреси, защото след move(key) стойността на key вече не е ключът.
+	template<typename K, typename First, typename... Rest>
+	static bool buildsFromKey(const K& key, const First& first, const Rest&... rest);
+
+	//типът се проверява, за да не се сбърка член, който започва на адреса на key, със самия key
+	template<typename K, typename Arg, typename... Rest>
+	static bool isKeyObject(const K& key, const Arg& arg, const Rest&...);
+public:
+	UnorderedSet();
+	UnorderedSet(const UnorderedSet& other);
+	UnorderedSet& operator=(const UnorderedSet& other);
+	UnorderedSet(UnorderedSet&& other); //other остава празно множество, готово за употреба
+	UnorderedSet& operator=(UnorderedSet&& other);
+	~UnorderedSet() = default;
+
+	//Строи множество от [first, last) с threadsCount нишки. Таблицата се оразмерява веднъж,
+	//ключовете се разпределят (radix) по диапазони от бъкети и всяка нишка пълни своя диапазон без заключване.
+	template<typename RandomIt>
+	static UnorderedSet build_parallel(RandomIt first, RandomIt last, unsigned threadsCount = thread::hardware_concurrency());
+
+	pair<Iterator, bool> insert(const Key& key);
+	pair<Iterator, bool> insert(Key&& key);
+
+	template<typename... Args>
+	pair<Iterator, bool> emplace(Args&&... args);
+
+	//Ключът се конструира от args само ако key липсва в множеството. Ако построеният ключ
+	//не е равен на key, той се добавя като при emplace - по собствения си хеш.
+	//Args (key) и (in_place, key, ...) със самия обект key се приемат за ключ, равен на key, без сравнение.
+	template<typename K, typename... Args, typename = EnableIfLookupKey<K>>
+	pair<Iterator, bool> try_emplace(const K& key, Args&&... args);
+
+	//Ако ключът вече го има, възелът остава в node
+	pair<Iterator, bool> insert(NodeHandle&& node);
+
+	NodeHandle extract(const Key& key);
+	NodeHandle extract(ConstIterator iter);
+
+	//Прехвърля възлите на other, чиито ключове липсват тук. Повторените ключове остават в other.
+	void merge(UnorderedSet& other);
+	void merge(UnorderedSet&& other);
+
+	//Обхожда се по-малкото множество. При threadsCount > 1 търсенията в другото
+	//се правят паралелно по диапазони от бъкети, а резултатът се строи с build_parallel.
+	//Резултатът пази hashSeed на по-голямото множество при обединение и на lhs при сечение и разлика.
+	static UnorderedSet set_union(const UnorderedSet& lhs, const UnorderedSet& rhs, unsigned threadsCount = 1);
+	static UnorderedSet set_intersection(const UnorderedSet& lhs, const UnorderedSet& rhs, unsigned threadsCount = 1);
+	static UnorderedSet set_difference(const UnorderedSet& lhs, const UnorderedSet& rhs, unsigned threadsCount = 1); //lhs \ rhs
 
 	void remove(const Key& key);
 	void remove(ConstIterator iter);
 
 	ConstIterator find(const Key& key) const;
+	bool contains(const Key& key) const;
+	size_t count(const Key& key) const;
+
+	template<typename K, typename = EnableIfTransparent<K>>
+	void remove(const K& key);
+
+	template<typename K, typename = EnableIfTransparent<K>>
+	ConstIterator find(const K& key) const;
+
+	template<typename K, typename = EnableIfTransparent<K>>
+	bool contains(const K& key) const;
+
+	template<typename K, typename = EnableIfTransparent<K>>
+	size_t count(const K& key) const;
+
+	//Пакетно търсене: бъкетите и после възлите се prefetch-ват няколко ключа напред, така че много промахвания
+	//в кеша се чакат едновременно. Таблица, която се събира в кеша, се обхожда с обикновено търсене.
+	template<typename K>
+	void contains_batch(const K* keys, size_t count, bool* outMask) const;
+
+	template<typename K>
+	void find_batch(const K* keys, size_t count, ConstIterator* outIters) const;
 
 	void clearSet();
 	bool empty() const;
+	size_t size() const;
+
+	//Един проход по всеки бъкет. Връща броя изтрити ключове.
+	template<typename Predicate>
+	size_t erase_if(const Predicate& pred);
+
+	//Бъкетите се разделят на threadsCount последователни диапазона, pred трябва да може да се вика от няколко нишки
+	template<typename Predicate>
+	size_t erase_if(const Predicate& pred, unsigned threadsCount);
 
+	//Оставя само ключовете, за които pred е вярно. Връща броя изтрити ключове.
 	template<typename Predicate>
-	void erase_if(const Predicate& pred);
+	size_t retain(const Predicate& pred, unsigned threadsCount = 1);
+
+	template<typename Function>
+	void for_each(const Function& func) const;
+
+	//func(key) се вика едновременно от threadsCount нишки. Дългите вериги не бавят останалите нишки,
+	//защото свършилите крадат работа (виж forEachBucketChunk).
+	template<typename Function>
+	void parallel_for_each(const Function& func, unsigned threadsCount = thread::hardware_concurrency()) const;
+
+	//combine(init, combine(map(k1), map(k2), ...)) в неопределен ред - combine трябва да е асоциативна и комутативна.
+	//init се ползва точно веднъж, затова не е нужно да е неутрален елемент.
+	template<typename T, typename Map, typename Combine>
+	T parallel_reduce(T init, const Map& map, const Combine& combine, unsigned threadsCount = thread::hardware_concurrency()) const;
 
 	void print() const;
 
@@ -114,159 +433,1217 @@ public:
 	Iterator begin();
 	Iterator end();
 
-	double loadFactor() const;
-};
+	double loadFactor() const;
+	double max_load_factor() const;
+	void max_load_factor(double ml);
+
+	//Ако е > 0, таблицата се смалява, щом след изтриване loadFactor() падне под ml. Трябва ml < max_load_factor() / 2.
+	double min_load_factor() const;
+	void min_load_factor(double ml);
+
+	//Оставя най-малкия брой бъкети, при който loadFactor() <= max_load_factor(), и освобождава излишния капацитет
+	void shrink_to_fit();
+
+	//Байтове, заявени от алокатора: обектът, бъкетите, възлите, динамичната памет на ключовете и индексите на дългите вериги
+	size_t memory_usage() const;
+
+	size_t bucket_count() const;
+	void rehash(size_t bucketsCount);
+	void reserve(size_t elements);
+
+	//Избира случайно зърно за разбъркване на хешовете на това множество и преразпределя ключовете
+	void randomizeHashSeed();
+};
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::getBucketIndex(size_t hash) const
+{
+	return bucketPolicy.index(hash ^ hashSeed);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::getNodeHash(const Node& node) const
+{
+	if constexpr (CacheHashCode<Key>::value)
+		return node.hash;
+	else
+		return getHash(node.key);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::nodeMatches(const Node& node, size_t hash, const K& key) const
+{
+	if constexpr (CacheHashCode<Key>::value)
+		return node.hash == hash && keyEqual(node.key, key);
+	else
+		return keyEqual(node.key, key);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Bucket::const_iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::findInBucket(size_t hashCode, size_t hash, const K& key) const
+{
+	const auto& bucket = hashTable[hashCode];
+	if constexpr (CAN_TREEIFY && IsLessComparable<Key, K>::value)
+	{
+		if (const ChainIndex* index = getChainIndex(hashCode))
+		{
+			auto pos = lowerBoundInChain(*index, key);
+			if (pos != index->end() && !less<>()(key, (*pos)->key))
+				return *pos;
+			return bucket.cend();
+		}
+	}
+
+	for (auto it = bucket.cbegin(); it != bucket.cend(); it++)
+	{
+		if (nodeMatches(*it, hash, key))
+			return it;
+	}
+	return bucket.cend();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Bucket::iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::findPrevInBucket(size_t hashCode, size_t hash, const K& key)
+{
+	auto& bucket = hashTable[hashCode];
+	if constexpr (CAN_TREEIFY && IsLessComparable<Key, K>::value)
+	{
+		//веригата на преобразуван бъкет е подредена като масива, затова предшественикът е предишният елемент в него
+		if (const ChainIndex* index = getChainIndex(hashCode))
+		{
+			auto pos = lowerBoundInChain(*index, key);
+			if (pos != index->end() && !less<>()(key, (*pos)->key))
+				return pos == index->begin() ? bucket.before_begin() : *(pos - 1);
+			return index->back();
+		}
+	}
+
+	auto prev = bucket.before_begin();
+	for (auto curr = bucket.begin(); curr != bucket.end(); curr++)
+	{
+		if (nodeMatches(*curr, hash, key))
+			break;
+
+		prev = curr;
+	}
+	return prev;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+const typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ChainIndex* UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::getChainIndex(size_t hashCode) const
+{
+	if (chainIndexes.empty())
+		return nullptr;
+
+	return chainIndexes[hashCode].get();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ChainIndex::const_iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::lowerBoundInChain(const ChainIndex& index, const K& key) const
+{
+	return lower_bound(index.begin(), index.end(), key, [](const typename Bucket::iterator& node, const K& searched) {
+		return less<>()(node->key, searched);
+	});
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::treeify(size_t hashCode)
+{
+	if (chainIndexes.empty())
+		chainIndexes.resize(hashTable.size());
+
+	auto& bucket = hashTable[hashCode];
+	//sort на forward_list пренасочва възлите, без да ги копира, и итераторите към тях остават валидни
+	bucket.sort([](const Node& lhs, const Node& rhs) { return lhs.key < rhs.key; });
+
+	auto index = make_unique<ChainIndex>();
+	for (auto it = bucket.begin(); it != bucket.end(); it++)
+		index->push_back(it);
+
+	chainIndexes[hashCode] = move(index);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::rebuildChainIndexes()
+{
+	vector<unique_ptr<ChainIndex>>().swap(chainIndexes);
+	if constexpr (CAN_TREEIFY)
+	{
+		for (size_t i = 0; i < hashTable.size(); i++)
+		{
+			size_t chainLength = 0;
+			for (auto it = hashTable[i].begin(); it != hashTable[i].end() && chainLength <= TREEIFY_THRESHOLD; it++)
+				chainLength++;
+
+			if (chainLength > TREEIFY_THRESHOLD)
+				treeify(i);
+		}
+	}
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Bucket::iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::linkNode(size_t hashCode, Bucket& node)
+{
+	auto& bucket = hashTable[hashCode];
+	typename Bucket::iterator inserted;
+
+	if constexpr (CAN_TREEIFY)
+	{
+		if (!chainIndexes.empty() && chainIndexes[hashCode])
+		{
+			ChainIndex& index = *chainIndexes[hashCode];
+			auto pos = index.begin() + (lowerBoundInChain(index, node.front().key) - index.cbegin());
+			auto prev = (pos == index.begin()) ? bucket.before_begin() : *(pos - 1);
+
+			bucket.splice_after(prev, node, node.before_begin());
+			inserted = next(prev);
+			index.insert(pos, inserted);
+		}
+		else
+		{
+			bucket.splice_after(bucket.before_begin(), node, node.before_begin());
+			inserted = bucket.begin();
+
+			size_t chainLength = 0;
+			for (auto it = bucket.begin(); it != bucket.end() && chainLength <= TREEIFY_THRESHOLD; it++)
+				chainLength++;
+
+			if (chainLength > TREEIFY_THRESHOLD)
+				treeify(hashCode);
+		}
+	}
+	else
+	{
+		bucket.splice_after(bucket.before_begin(), node, node.before_begin());
+		inserted = bucket.begin();
+	}
+
+	elementsCount++;
+	if (hashCode < firstNonEmptyBucket)
+		firstNonEmptyBucket = hashCode;
+
+	return inserted;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::unlinkAfter(size_t hashCode, typename Bucket::iterator prev, Bucket& out)
+{
+	auto& bucket = hashTable[hashCode];
+	if constexpr (CAN_TREEIFY)
+	{
+		if (!chainIndexes.empty() && chainIndexes[hashCode])
+		{
+			ChainIndex& index = *chainIndexes[hashCode];
+			auto pos = index.begin() + (lowerBoundInChain(index, next(prev)->key) - index.cbegin());
+			index.erase(pos);
+
+			if (index.size() < UNTREEIFY_THRESHOLD)
+				chainIndexes[hashCode].reset();
+		}
+	}
+
+	out.splice_after(out.before_begin(), bucket, prev);
+	elementsCount--;
+	if (hashCode == firstNonEmptyBucket && bucket.empty())
+		skipEmptyBuckets();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::skipEmptyBuckets()
+{
+	//границата само расте до следващото добавяне, затова изтриването отпред е амортизирано O(1)
+	while (firstNonEmptyBucket < hashTable.size() && hashTable[firstNonEmptyBucket].empty())
+		firstNonEmptyBucket++;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::eraseAfter(size_t hashCode, typename Bucket::iterator prev)
+{
+	Bucket removed;
+	unlinkAfter(hashCode, prev, removed);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::removeKey(const K& key)
+{
+	size_t hash = getHash(key);
+	size_t hashCode = getBucketIndex(hash);
+	auto& bucket = hashTable[hashCode];
+
+	auto prev = findPrevInBucket(hashCode, hash, key);
+	if (next(prev) != bucket.end())
+	{
+		eraseAfter(hashCode, prev);
+		shrinkIfSparse();
+	}
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::prefetchFirstNode(size_t hashCode) const
+{
+	const auto& bucket = hashTable[hashCode];
+	if (!bucket.empty())
+		prefetchForRead(&bucket.front());
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename Resolver>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::probeBatch(const K* keys, size_t count, const Resolver& resolve) const
+{
+	size_t tableBytes = hashTable.size() * sizeof(Bucket) + elementsCount * (sizeof(Node) + sizeof(void*));
+	if (tableBytes < BATCH_PREFETCH_MIN_BYTES)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t hash = getHash(keys[i]);
+			size_t hashCode = getBucketIndex(hash);
+			resolve(i, hashCode, findInBucket(hashCode, hash, keys[i]));
+		}
+		return;
+	}
+
+	size_t hashes[BATCH_RING_SIZE];
+	size_t hashCodes[BATCH_RING_SIZE];
+	auto prefetchBucket = [&](size_t i) {
+		size_t slot = i & (BATCH_RING_SIZE - 1);
+		hashes[slot] = getHash(keys[i]);
+		hashCodes[slot] = getBucketIndex(hashes[slot]);
+		prefetchForRead(&hashTable[hashCodes[slot]]);
+	};
+
+	for (size_t i = 0; i < count && i < 2 * PREFETCH_DISTANCE; i++)
+		prefetchBucket(i);
+	for (size_t i = 0; i < count && i < PREFETCH_DISTANCE; i++)
+		prefetchFirstNode(hashCodes[i]);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (i + 2 * PREFETCH_DISTANCE < count)
+			prefetchBucket(i + 2 * PREFETCH_DISTANCE);
+		if (i + PREFETCH_DISTANCE < count)
+			prefetchFirstNode(hashCodes[(i + PREFETCH_DISTANCE) & (BATCH_RING_SIZE - 1)]);
+
+		size_t slot = i & (BATCH_RING_SIZE - 1);
+		resolve(i, hashCodes[slot], findInBucket(hashCodes[slot], hashes[slot], keys[i]));
+	}
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Function>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::runParallel(unsigned threadsCount, const Function& func)
+{
+	exception_ptr error;
+	mutex errorMutex;
+	auto guarded = [&](unsigned index) {
+		try
+		{
+			func(index);
+		}
+		catch (...)
+		{
+			lock_guard<mutex> lock(errorMutex);
+			if (!error)
+				error = current_exception();
+		}
+	};
+
+	vector<thread> workers;
+	workers.reserve(threadsCount - 1);
+	try
+	{
+		for (unsigned i = 1; i < threadsCount; i++)
+			workers.emplace_back(guarded, i);
+	}
+	catch (...)
+	{
+		//унищожаването на joinable нишка вика std::terminate, затова пуснатите се изчакват
+		for (thread& worker : workers)
+			worker.join();
+		throw;
+	}
+
+	guarded(0);
+	for (thread& worker : workers)
+		worker.join();
+
+	if (error)
+		rethrow_exception(error);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::resize(size_t newBucketsCount)
+{
+	vector<Bucket> newHashTable(newBucketsCount);
+	BucketPolicy newBucketPolicy;
+	newBucketPolicy.setBucketsCount(newBucketsCount);
+
+	//възлите се пренасочват със splice_after, без копиране на ключовете
+	for (auto& bucket : hashTable)
+	{
+		while (!bucket.empty())
+		{
+			auto& newBucket = newHashTable[newBucketPolicy.index(getNodeHash(bucket.front()) ^ hashSeed)];
+			newBucket.splice_after(newBucket.before_begin(), bucket, bucket.before_begin());
+		}
+	}
+	hashTable = move(newHashTable);
+	bucketPolicy = newBucketPolicy;
+	firstNonEmptyBucket = 0;
+	skipEmptyBuckets();
+	rebuildChainIndexes();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::getBucketsCountFor(size_t elements) const
+{
+	size_t minBucketsCount = static_cast<size_t>(ceil(elements / maxLoadFactor));
+	return BucketPolicy::roundBucketsCount(max(minBucketsCount, BucketPolicyConstants::MIN_BUCKETS_COUNT));
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::needsGrowth() const
+{
+	return elementsCount + 1 > maxLoadFactor * hashTable.size();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::shrinkIfSparse()
+{
+	if (minLoadFactor > 0 && loadFactor() < minLoadFactor)
+		shrink_to_fit();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::UnorderedSet()
+{
+	hashTable.resize(BucketPolicy::roundBucketsCount(BucketPolicyConstants::MIN_BUCKETS_COUNT));
+	bucketPolicy.setBucketsCount(hashTable.size());
+	firstNonEmptyBucket = hashTable.size();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::UnorderedSet(const UnorderedSet& other)
+	: hashTable(other.hashTable), elementsCount(other.elementsCount), firstNonEmptyBucket(other.firstNonEmptyBucket),
+	maxLoadFactor(other.maxLoadFactor), minLoadFactor(other.minLoadFactor), getHash(other.getHash), keyEqual(other.keyEqual), bucketPolicy(other.bucketPolicy), hashSeed(other.hashSeed)
+{
+	//индексите пазят итератори към възлите на other, затова се строят наново
+	rebuildChainIndexes();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>& UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::operator=(const UnorderedSet& other)
+{
+	if (this != &other)
+	{
+		UnorderedSet copy(other);
+		*this = move(copy);
+	}
+	return *this;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::UnorderedSet(UnorderedSet&& other)
+	: hashTable(move(other.hashTable)), elementsCount(other.elementsCount), firstNonEmptyBucket(other.firstNonEmptyBucket),
+	maxLoadFactor(other.maxLoadFactor), minLoadFactor(other.minLoadFactor), getHash(move(other.getHash)), keyEqual(move(other.keyEqual)),
+	bucketPolicy(other.bucketPolicy), hashSeed(other.hashSeed), chainIndexes(move(other.chainIndexes))
+{
+	//възлите не се местят, така че итераторите в chainIndexes остават валидни
+	other.clearSet();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>& UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::operator=(UnorderedSet&& other)
+{
+	if (this != &other)
+	{
+		hashTable = move(other.hashTable);
+		elementsCount = other.elementsCount;
+		firstNonEmptyBucket = other.firstNonEmptyBucket;
+		maxLoadFactor = other.maxLoadFactor;
+		minLoadFactor = other.minLoadFactor;
+		getHash = move(other.getHash);
+		keyEqual = move(other.keyEqual);
+		bucketPolicy = other.bucketPolicy;
+		hashSeed = other.hashSeed;
+		chainIndexes = move(other.chainIndexes);
+		other.clearSet();
+	}
+	return *this;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename RandomIt>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::build_parallel(RandomIt first, RandomIt last, unsigned threadsCount)
+{
+	static_assert(is_base_of<random_access_iterator_tag, typename iterator_traits<RandomIt>::iterator_category>::value,
+		"build_parallel needs random access iterators");
+
+	return buildFromIndexed(last - first, [first](size_t i) -> decltype(auto) { return first[i]; }, threadsCount, 0);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Function>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::forEachBucketChunk(unsigned threadsCount, const Function& func) const
+{
+	constexpr size_t CHUNKS_PER_THREAD = 32;
+	constexpr uint64_t LOW_MASK = 0xFFFFFFFFu;
+
+	size_t bucketsCount = hashTable.size();
+	threadsCount = max(1u, threadsCount);
+	size_t chunksCount = min(bucketsCount, static_cast<size_t>(threadsCount) * CHUNKS_PER_THREAD);
+	if (chunksCount < threadsCount)
+		threadsCount = 1;
+
+	auto pack = [](uint64_t front, uint64_t back) { return (front << 32) | back; };
+	auto chunkStart = [bucketsCount, chunksCount](size_t chunk) { return bucketsCount * chunk / chunksCount; };
+
+	struct alignas(64) ChunkRange
+	{
+		atomic<uint64_t> range;
+	};
+	vector<ChunkRange> ranges(threadsCount);
+	for (unsigned t = 0; t < threadsCount; t++)
+		ranges[t].range.store(pack(chunksCount * t / threadsCount, chunksCount * (t + 1) / threadsCount), memory_order_relaxed);
+
+	runParallel(threadsCount, [&](unsigned t) {
+		atomic<uint64_t>& own = ranges[t].range;
+		while (true)
+		{
+			uint64_t curr = own.load(memory_order_acquire);
+			while ((curr >> 32) < (curr & LOW_MASK))
+			{
+				if (own.compare_exchange_weak(curr, pack((curr >> 32) + 1, curr & LOW_MASK), memory_order_acq_rel))
+				{
+					size_t chunk = curr >> 32;
+					func(t, chunkStart(chunk), chunkStart(chunk + 1));
+					curr = own.load(memory_order_acquire);
+				}
+			}
+
+			//собственият диапазон е празен - краде се половината от първия непразен чужд
+			bool stolen = false;
+			for (unsigned i = 1; i < threadsCount && !stolen; i++)
+			{
+				atomic<uint64_t>& victim = ranges[(t + i) % threadsCount].range;
+				uint64_t victimRange = victim.load(memory_order_acquire);
+				while (!stolen && (victimRange >> 32) < (victimRange & LOW_MASK))
+				{
+					uint64_t front = victimRange >> 32, back = victimRange & LOW_MASK;
+					uint64_t newBack = back - (back - front + 1) / 2;
+					if (victim.compare_exchange_weak(victimRange, pack(front, newBack), memory_order_acq_rel))
+					{
+						own.store(pack(newBack, back), memory_order_release);
+						stolen = true;
+					}
+				}
+			}
+
+			if (!stolen)
+				return;
+		}
+	});
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename KeyAt>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::buildFromIndexed(size_t count, const KeyAt& keyAt, unsigned threadsCount, size_t seed)
+{
+	UnorderedSet result;
+	result.hashSeed = seed;
+	size_t bucketsCount = result.getBucketsCountFor(count);
+	result.hashTable = vector<Bucket>(bucketsCount);
+	result.bucketPolicy.setBucketsCount(bucketsCount);
+
+	threadsCount = max(1u, threadsCount);
+	if (count < threadsCount)
+		threadsCount = 1;
+
+	//нишка t първо чете входа [inputStart(t), inputStart(t + 1)), а после пълни бъкетите от дял t
+	auto inputStart = [count, threadsCount](size_t t) { return count * t / threadsCount; };
+	auto partitionOf = [bucketsCount, threadsCount](size_t bucket) { return bucket * threadsCount / bucketsCount; };
+
+	vector<size_t> hashOf(count);
+	vector<size_t> bucketOf(count);
+	vector<size_t> offsets(static_cast<size_t>(threadsCount) * threadsCount, 0); //offsets[t * threadsCount + p]
+
+	runParallel(threadsCount, [&](unsigned t) {
+		size_t* histogram = &offsets[static_cast<size_t>(t) * threadsCount];
+		for (size_t i = inputStart(t); i < inputStart(t + 1); i++)
+		{
+			hashOf[i] = result.getHash(keyAt(i));
+			bucketOf[i] = result.getBucketIndex(hashOf[i]);
+			histogram[partitionOf(bucketOf[i])]++;
+		}
+	});
+
+	//подредба по дял, а в рамките на дяла - по нишката, която е прочела ключа
+	vector<size_t> partitionStart(threadsCount + 1, 0);
+	size_t position = 0;
+	for (size_t p = 0; p < threadsCount; p++)
+	{
+		partitionStart[p] = position;
+		for (size_t t = 0; t < threadsCount; t++)
+		{
+			size_t histogramCount = offsets[t * threadsCount + p];
+			offsets[t * threadsCount + p] = position;
+			position += histogramCount;
+		}
+	}
+	partitionStart[threadsCount] = position;
+
+	vector<size_t> order(count);
+	runParallel(threadsCount, [&](unsigned t) {
+		size_t* nextSlot = &offsets[static_cast<size_t>(t) * threadsCount];
+		for (size_t i = inputStart(t); i < inputStart(t + 1); i++)
+			order[nextSlot[partitionOf(bucketOf[i])]++] = i;
+	});
+
+	//еднаквите ключове попадат в един бъкет, следователно и в един дял
+	vector<size_t> insertedCount(threadsCount, 0);
+	runParallel(threadsCount, [&](unsigned p) {
+		for (size_t j = partitionStart[p]; j < partitionStart[p + 1]; j++)
+		{
+			size_t i = order[j];
+			size_t hashCode = bucketOf[i];
+			if (result.findInBucket(hashCode, hashOf[i], keyAt(i)) != result.hashTable[hashCode].cend())
+				continue;
+
+			result.hashTable[hashCode].emplace_front(in_place, keyAt(i));
+			result.hashTable[hashCode].front().setHash(hashOf[i]);
+			insertedCount[p]++;
+		}
+	});
+
+	for (size_t p = 0; p < threadsCount; p++)
+		result.elementsCount += insertedCount[p];
+	result.firstNonEmptyBucket = 0;
+	result.skipEmptyBuckets();
+	result.rebuildChainIndexes();
+	return result;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Predicate>
+vector<const Key*> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::collectKeys(const UnorderedSet& source, const Predicate& keep, unsigned threadsCount)
+{
+	size_t bucketsCount = source.hashTable.size();
+	threadsCount = max(1u, threadsCount);
+	if (bucketsCount < threadsCount)
+		threadsCount = 1;
+
+	vector<vector<const Key*>> collected(threadsCount);
+	runParallel(threadsCount, [&](unsigned t) {
+		for (size_t i = bucketsCount * t / threadsCount; i < bucketsCount * (t + 1) / threadsCount; i++)
+		{
+			for (const Node& node : source.hashTable[i])
+			{
+				if (keep(node.key, source.getNodeHash(node)))
+					collected[t].push_back(&node.key);
+			}
+		}
+	});
+
+	vector<const Key*> result = move(collected[0]);
+	for (unsigned t = 1; t < threadsCount; t++)
+		result.insert(result.end(), collected[t].begin(), collected[t].end());
+	return result;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+pair<typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator, bool> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::insert(const Key& key)
+{
+	return try_emplace(key, key);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+pair<typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator, bool> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::insert(Key&& key)
+{
+	return try_emplace(key, move(key));
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename... Args>
+pair<typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator, bool> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::emplace(Args&&... args)
+{
+	//ключът се конструира направо във възел, който после се прехвърля в бъкета без копиране
+	Bucket node;
+	node.emplace_front(in_place, forward<Args>(args)...);
+	return emplaceNode(node);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+pair<typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator, bool> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::emplaceNode(Bucket& node)
+{
+	const Key& key = node.front().key;
+
+	size_t hash = getHash(key);
+	node.front().setHash(hash);
+
+	size_t hashCode = getBucketIndex(hash);
+	auto prev = findPrevInBucket(hashCode, hash, key);
+	if (next(prev) != hashTable[hashCode].end())
+		return { Iterator(this, hashCode, next(prev)), false };
+
+	if (needsGrowth())
+	{
+		resize(BucketPolicy::roundBucketsCount(hashTable.size() * 2));
+		hashCode = getBucketIndex(hash);
+	}
+
+	return { Iterator(this, hashCode, linkNode(hashCode, node)), true };
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename First, typename... Rest>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::buildsFromKey(const K& key, const First& first, const Rest&... rest)
+{
+	if constexpr (is_same<First, in_place_t>::value && sizeof...(Rest) > 0)
+		return isKeyObject(key, rest...);
+	else if constexpr (sizeof...(Rest) == 0 && is_same<First, Key>::value)
+		return isKeyObject(key, first);
+	else
+		return false;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename Arg, typename... Rest>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::isKeyObject(const K& key, const Arg& arg, const Rest&...)
+{
+	if constexpr (is_same<Arg, K>::value)
+		return addressof(arg) == addressof(key);
+	else
+		return false;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename... Args, typename>
+pair<typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator, bool> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::try_emplace(const K& key, Args&&... args)
+{
+	size_t hash = getHash(key);
+	size_t hashCode = getBucketIndex(hash);
+	auto prev = findPrevInBucket(hashCode, hash, key);
+	if (next(prev) != hashTable[hashCode].end())
+		return { Iterator(this, hashCode, next(prev)), false };
+
+	if (needsGrowth())
+	{
+		resize(BucketPolicy::roundBucketsCount(hashTable.size() * 2));
+		hashCode = getBucketIndex(hash);
+	}
+
+	Bucket node;
+	if constexpr (sizeof...(Args) == 0)
+		node.emplace_front(in_place, key);
+	else
+	{
+		//адресите се сравняват преди конструирането, което може да премести key
+		bool fromKey = buildsFromKey(key, args...);
+		node.emplace_front(in_place, forward<Args>(args)...);
+		if (!fromKey && !keyEqual(node.front().key, key))
+			return emplaceNode(node);
+	}
+	node.front().setHash(hash);
+
+	return { Iterator(this, hashCode, linkNode(hashCode, node)), true };
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+pair<typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator, bool> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::insert(NodeHandle&& node)
+{
+	if (node.empty())
+		return { end(), false };
+
+	//ключът може да е променян през value(), затова хешът се смята наново
+	const Key& key = node.node.front().key;
+	size_t hash = getHash(key);
+	node.node.front().setHash(hash);
+
+	size_t hashCode = getBucketIndex(hash);
+	auto prev = findPrevInBucket(hashCode, hash, key);
+	if (next(prev) != hashTable[hashCode].end())
+		return { Iterator(this, hashCode, next(prev)), false };
+
+	if (needsGrowth())
+	{
+		resize(BucketPolicy::roundBucketsCount(hashTable.size() * 2));
+		hashCode = getBucketIndex(hash);
+	}
+
+	return { Iterator(this, hashCode, linkNode(hashCode, node.node)), true };
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::NodeHandle UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::extract(const Key& key)
+{
+	NodeHandle result;
+	size_t hash = getHash(key);
+	size_t hashCode = getBucketIndex(hash);
+
+	auto prev = findPrevInBucket(hashCode, hash, key);
+	if (next(prev) != hashTable[hashCode].end())
+	{
+		unlinkAfter(hashCode, prev, result.node);
+		shrinkIfSparse();
+	}
+
+	return result;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::NodeHandle UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::extract(ConstIterator iter)
+{
+	NodeHandle result;
+	if (iter.bucketIndex >= hashTable.size())
+		return result;
+
+	auto& bucket = hashTable[iter.bucketIndex];
+
+	auto prev = bucket.before_begin();
+	for (auto curr = bucket.begin(); curr != bucket.end(); curr++)
+	{
+		if (curr == iter.currElementIter)
+		{
+			unlinkAfter(iter.bucketIndex, prev, result.node);
+			shrinkIfSparse();
+			break;
+		}
+
+		prev = curr;
+	}
+	return result;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::merge(UnorderedSet& other)
+{
+	if (this == &other)
+		return;
+
+	for (size_t i = 0; i < other.hashTable.size(); i++)
+	{
+		auto& otherBucket = other.hashTable[i];
+		auto prev = otherBucket.before_begin();
+		while (next(prev) != otherBucket.end())
+		{
+			const Node& node = *next(prev);
+			size_t hash = other.getNodeHash(node);
+			size_t hashCode = getBucketIndex(hash);
+			if (findInBucket(hashCode, hash, node.key) != hashTable[hashCode].cend())
+			{
+				prev++;
+				continue;
+			}
+
+			if (needsGrowth())
+			{
+				resize(BucketPolicy::roundBucketsCount(hashTable.size() * 2));
+				hashCode = getBucketIndex(hash);
+			}
+
+			Bucket moved;
+			other.unlinkAfter(i, prev, moved);
+			moved.front().setHash(hash);
+			linkNode(hashCode, moved);
+		}
+	}
+	other.shrinkIfSparse();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::merge(UnorderedSet&& other)
+{
+	merge(other);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::set_union(const UnorderedSet& lhs, const UnorderedSet& rhs, unsigned threadsCount)
+{
+	const UnorderedSet& smaller = lhs.size() <= rhs.size() ? lhs : rhs;
+	const UnorderedSet& larger = lhs.size() <= rhs.size() ? rhs : lhs;
+
+	vector<const Key*> missing = collectKeys(smaller, [&larger](const Key& key, size_t hash) {
+		size_t hashCode = larger.getBucketIndex(hash);
+		return larger.findInBucket(hashCode, hash, key) == larger.hashTable[hashCode].cend();
+	}, threadsCount);
+
+	if (threadsCount <= 1)
+	{
+		//копието запазва възлите на larger подредени по бъкети и не ги хешира наново
+		UnorderedSet result(larger);
+		result.reserve(larger.size() + missing.size());
+		for (const Key* key : missing)
+			result.insert(*key);
+		return result;
+	}
+
+	vector<const Key*> keys = collectKeys(larger, [](const Key&, size_t) { return true; }, threadsCount);
+	keys.insert(keys.end(), missing.begin(), missing.end());
+	return buildFromIndexed(keys.size(), [&keys](size_t i) -> const Key& { return *keys[i]; }, threadsCount, larger.hashSeed);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::set_intersection(const UnorderedSet& lhs, const UnorderedSet& rhs, unsigned threadsCount)
+{
+	const UnorderedSet& smaller = lhs.size() <= rhs.size() ? lhs : rhs;
+	const UnorderedSet& larger = lhs.size() <= rhs.size() ? rhs : lhs;
+
+	vector<const Key*> common = collectKeys(smaller, [&larger](const Key& key, size_t hash) {
+		size_t hashCode = larger.getBucketIndex(hash);
+		return larger.findInBucket(hashCode, hash, key) != larger.hashTable[hashCode].cend();
+	}, threadsCount);
+
+	return buildFromIndexed(common.size(), [&common](size_t i) -> const Key& { return *common[i]; }, threadsCount, lhs.hashSeed);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy> UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::set_difference(const UnorderedSet& lhs, const UnorderedSet& rhs, unsigned threadsCount)
+{
+	if (lhs.size() <= rhs.size())
+	{
+		vector<const Key*> kept = collectKeys(lhs, [&rhs](const Key& key, size_t hash) {
+			size_t hashCode = rhs.getBucketIndex(hash);
+			return rhs.findInBucket(hashCode, hash, key) == rhs.hashTable[hashCode].cend();
+		}, threadsCount);
+
+		return buildFromIndexed(kept.size(), [&kept](size_t i) -> const Key& { return *kept[i]; }, threadsCount, lhs.hashSeed);
+	}
+
+	//rhs е по-малкото - обхожда се то и ключовете му се махат от копие на lhs
+	UnorderedSet result(lhs);
+	for (const Bucket& bucket : rhs.hashTable)
+	{
+		for (const Node& node : bucket)
+		{
+			size_t hash = rhs.getNodeHash(node);
+			size_t hashCode = result.getBucketIndex(hash);
+			auto prev = result.findPrevInBucket(hashCode, hash, node.key);
+			if (next(prev) != result.hashTable[hashCode].end())
+				result.eraseAfter(hashCode, prev);
+		}
+	}
+	result.shrinkIfSparse();
+	return result;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::remove(const Key& key)
+{
+	removeKey(key);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::remove(const K& key)
+{
+	removeKey(key);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::remove(ConstIterator iter)
+{
+	if (iter.bucketIndex >= hashTable.size())
+		return;
+
+	auto& bucket = hashTable[iter.bucketIndex];
+
+	auto prev = bucket.before_begin();
+	for (auto curr = bucket.begin(); curr != bucket.end(); curr++)
+	{
+		if (curr == iter.currElementIter)
+		{
+			eraseAfter(iter.bucketIndex, prev);
+			shrinkIfSparse();
+			return;
+		}
+
+		prev = curr;
+	}
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::find(const Key& key) const
+{
+	size_t hash = getHash(key);
+	size_t hashCode = getBucketIndex(hash);
+	auto it = findInBucket(hashCode, hash, key);
+	if (it == hashTable[hashCode].cend())
+		return cend();
+
+	return ConstIterator(this, hashCode, it);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::find(const K& key) const
+{
+	size_t hash = getHash(key);
+	size_t hashCode = getBucketIndex(hash);
+	auto it = findInBucket(hashCode, hash, key);
+	if (it == hashTable[hashCode].cend())
+		return cend();
+
+	return ConstIterator(this, hashCode, it);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::findMutable(const K& key)
+{
+	size_t hash = getHash(key);
+	size_t hashCode = getBucketIndex(hash);
+	auto prev = findPrevInBucket(hashCode, hash, key);
+	if (next(prev) == hashTable[hashCode].end())
+		return end();
+
+	return Iterator(this, hashCode, next(prev));
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::contains(const Key& key) const
+{
+	size_t hash = getHash(key);
+	size_t hashCode = getBucketIndex(hash);
+	return findInBucket(hashCode, hash, key) != hashTable[hashCode].cend();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::contains(const K& key) const
+{
+	size_t hash = getHash(key);
+	size_t hashCode = getBucketIndex(hash);
+	return findInBucket(hashCode, hash, key) != hashTable[hashCode].cend();
+}
 
-template<typename Key, typename Hash>
-size_t UnorderedSet<Key, Hash>::getHashCode(const Key& key) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::count(const Key& key) const
 {
-	return getHash(key) % hashTable.size();
+	return contains(key) ? 1 : 0;
 }
 
-template<typename Key, typename Hash>
-void UnorderedSet<Key, Hash>::resize()
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K, typename>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::count(const K& key) const
 {
-	vector<forward_list<Key>> newHashTable(hashTable.size() * 2);
+	return contains(key) ? 1 : 0;
+}
 
-	for (int i = 0; i < hashTable.size(); i++)
-	{
-		for (auto it = hashTable[i].begin(); it != hashTable[i].end(); it++)
-		{
-			size_t newHashCode = getHash(*it) % newHashTable.size();
-			newHashTable[newHashCode].push_front(*it);
-		}
-	}
-	hashTable = move(newHashTable);
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::contains_batch(const K* keys, size_t count, bool* outMask) const
+{
+	probeBatch(keys, count, [this, outMask](size_t index, size_t hashCode, typename Bucket::const_iterator it) {
+		outMask[index] = (it != hashTable[hashCode].cend());
+	});
 }
 
-template<typename Key, typename Hash>
-int UnorderedSet<Key, Hash>::getElementsCount() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename K>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::find_batch(const K* keys, size_t count, ConstIterator* outIters) const
 {
-	int count = 0;
-	for (int i = 0; i < hashTable.size(); i++)
-	{
-		for (auto it = hashTable[i].begin(); it != hashTable[i].end(); it++)
-			count++;
-	}
-	return count;
+	probeBatch(keys, count, [this, outIters](size_t index, size_t hashCode, typename Bucket::const_iterator it) {
+		outIters[index] = (it != hashTable[hashCode].cend()) ? ConstIterator(this, hashCode, it) : cend();
+	});
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::clearSet()
+{
+	//новите вектори освобождават капацитета, който resize/clear биха запазили
+	vector<Bucket>(BucketPolicy::roundBucketsCount(BucketPolicyConstants::MIN_BUCKETS_COUNT)).swap(hashTable);
+	bucketPolicy.setBucketsCount(hashTable.size());
+	vector<unique_ptr<ChainIndex>>().swap(chainIndexes);
+	elementsCount = 0;
+	firstNonEmptyBucket = hashTable.size();
 }
 
-template<typename Key, typename Hash>
-UnorderedSet<Key, Hash>::UnorderedSet()
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::empty() const
 {
-	hashTable.resize(8);
+	return elementsCount == 0;
 }
 
-template<typename Key, typename Hash>
-void UnorderedSet<Key, Hash>::insert(const Key& key)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::size() const
 {
-	if (loadFactor() >= maxLoadFactor) 
-        resize();
+	return elementsCount;
+}
 
-	size_t hashCode = getHashCode(key);
-	auto& bucket = hashTable[hashCode];
-	for (auto it = bucket.begin(); it != bucket.end(); it++)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Predicate>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::erase_if(const Predicate& pred)
+{
+	size_t erasedCount = 0;
+	try
 	{
-		if (*it == key)
-			return;
+		eraseIfInBuckets(pred, 0, hashTable.size(), erasedCount);
+	}
+	catch (...)
+	{
+		//изтритите до момента възли остават изтрити, а броят и границата се оправят
+		elementsCount -= erasedCount;
+		skipEmptyBuckets();
+		throw;
 	}
 
-	bucket.push_front(key);
+	elementsCount -= erasedCount;
+	skipEmptyBuckets();
+	shrinkIfSparse();
+	return erasedCount;
 }
 
-template<typename Key, typename Hash>
-void UnorderedSet<Key, Hash>::remove(const Key& key)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Predicate>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::erase_if(const Predicate& pred, unsigned threadsCount)
 {
-	size_t hashCode = getHashCode(key);
-	auto& bucket = hashTable[hashCode];
+	size_t bucketsCount = hashTable.size();
+	threadsCount = max(1u, threadsCount);
+	if (bucketsCount < threadsCount)
+		threadsCount = 1;
+
+	//runParallel изчаква всички нишки преди да хвърли, така че броячите са крайни и при изключение
+	vector<size_t> erasedCounts(threadsCount, 0);
+	auto sumErased = [&erasedCounts]() {
+		size_t erasedCount = 0;
+		for (size_t count : erasedCounts)
+			erasedCount += count;
+		return erasedCount;
+	};
 
-	auto prev = bucket.before_begin();
-	for(auto curr = bucket.begin(); curr != bucket.end(); curr++)
+	try
 	{
-		if (*curr == key)
-		{
-			bucket.erase_after(prev);
-			return;
-		}
-
-		prev = curr;
+		runParallel(threadsCount, [&](unsigned t) {
+			eraseIfInBuckets(pred, bucketsCount * t / threadsCount, bucketsCount * (t + 1) / threadsCount, erasedCounts[t]);
+		});
+	}
+	catch (...)
+	{
+		elementsCount -= sumErased();
+		skipEmptyBuckets();
+		throw;
 	}
+
+	size_t erasedCount = sumErased();
+	elementsCount -= erasedCount;
+	skipEmptyBuckets();
+	shrinkIfSparse();
+	return erasedCount;
 }
 
-template<typename Key, typename Hash>
-void UnorderedSet<Key, Hash>::remove(ConstIterator iter)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Predicate>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::retain(const Predicate& pred, unsigned threadsCount)
 {
-	size_t hashCode = getHashCode(*iter);
-	auto& bucket = hashTable[hashCode];
+	return erase_if([&pred](const Key& key) { return !pred(key); }, threadsCount);
+}
 
-	auto prev = bucket.before_begin();
-	for (auto curr = bucket.begin(); curr != bucket.end(); curr++)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Predicate>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::eraseIfInBuckets(const Predicate& pred, size_t from, size_t to, size_t& erasedCount)
+{
+	for (size_t i = from; i < to; i++)
 	{
-		if (*curr == *iter)
+		//масивът се пуска преди триенето, за да не държи итератори към освободени възли, ако pred хвърли.
+		//Без него веригата е обикновен списък, а следващото вмъкване я преобразува отново при нужда.
+		bool wasTreeified = false;
+		if constexpr (CAN_TREEIFY)
 		{
-			bucket.erase_after(prev);
-			return;
+			if (getChainIndex(i))
+			{
+				chainIndexes[i].reset();
+				wasTreeified = true;
+			}
 		}
 
-		prev = curr;
+		auto& bucket = hashTable[i];
+		auto prev = bucket.before_begin();
+		for (auto curr = bucket.begin(); curr != bucket.end(); curr = next(prev))
+		{
+			if (pred(curr->key))
+			{
+				bucket.erase_after(prev);
+				erasedCount++;
+			}
+			else
+				prev = curr;
+		}
+
+		//веригата остава подредена, затова само масивът се строи наново
+		if constexpr (CAN_TREEIFY)
+		{
+			if (wasTreeified && size_t(distance(bucket.begin(), bucket.end())) >= UNTREEIFY_THRESHOLD)
+				treeify(i);
+		}
 	}
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::ConstIterator UnorderedSet<Key, Hash>::find(const Key& key) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Function>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::for_each(const Function& func) const
 {
-	size_t hashCode = getHashCode(key);
-	for (auto it = hashTable[hashCode].cbegin(); it != hashTable[hashCode].cend(); it++)
+	for (const auto& bucket : hashTable)
 	{
-		if (*it == key)
-			return ConstIterator(it);
+		for (const Node& node : bucket)
+			func(node.key);
 	}
-	return cend();
 }
 
-template<typename Key, typename Hash>
-void UnorderedSet<Key, Hash>::clearSet()
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename Function>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::parallel_for_each(const Function& func, unsigned threadsCount) const
 {
-	for (int i = 0; i < hashTable.size(); i++)
-		hashTable[i].clear();
-
-	hashTable.resize(8);
+	forEachBucketChunk(threadsCount, [&](unsigned, size_t from, size_t to) {
+		for (size_t i = from; i < to; i++)
+		{
+			for (const Node& node : hashTable[i])
+				func(node.key);
+		}
+	});
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::empty() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+template<typename T, typename Map, typename Combine>
+T UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::parallel_reduce(T init, const Map& map, const Combine& combine, unsigned threadsCount) const
 {
-	for (const auto& bucket : hashTable)
+	struct alignas(64) Partial
 	{
-		if (!bucket.empty())
-			return false;
-	}
-	return true;
-}
+		optional<T> value;
+	};
+	vector<Partial> partials(max(1u, threadsCount));
 
-template<typename Key, typename Hash>
-template<typename Predicate>
-void UnorderedSet<Key, Hash>::erase_if(const Predicate& pred)
-{
-	for (int i = 0; i < hashTable.size(); i++)
-	{
-		for (auto it = hashTable[i].begin(); it != hashTable[i].end(); it++)
+	forEachBucketChunk(threadsCount, [&](unsigned t, size_t from, size_t to) {
+		optional<T>& partial = partials[t].value;
+		for (size_t i = from; i < to; i++)
 		{
-			if (pred(*it))
+			for (const Node& node : hashTable[i])
 			{
-				ConstIterator iter(it);
-				remove(iter);
+				if (partial)
+					partial = combine(move(*partial), map(node.key));
+				else
+					partial.emplace(map(node.key));
 			}
 		}
+	});
+
+	for (Partial& partial : partials)
+	{
+		if (partial.value)
+			init = combine(move(init), move(*partial.value));
 	}
+	return init;
 }
 
-template<typename Key, typename Hash>
-void UnorderedSet<Key, Hash>::print() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::print() const
 {
 	for (int i = 0; i < hashTable.size(); i++) {
 		for (auto it = hashTable[i].begin(); it != hashTable[i].end(); it++)
-			cout << *it << ' ';
+			cout << it->key << ' ';
 
 		if (hashTable[i].empty())
 			continue;
@@ -275,516 +1652,428 @@ void UnorderedSet<Key, Hash>::print() const
 	}
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::ConstIterator UnorderedSet<Key, Hash>::cbegin() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::cbegin() const
 {
-	for (size_t i = 0; i < hashTable.size(); i++) 
-	{
-		if (!hashTable[i].empty()) 
-		{
-			return ConstIterator(*this, hashTable[i].cbegin());
-		}
-	}
-	return cend();
+	if (firstNonEmptyBucket == hashTable.size())
+		return cend();
+
+	return ConstIterator(this, firstNonEmptyBucket, hashTable[firstNonEmptyBucket].cbegin());
 }
-	
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::ConstIterator UnorderedSet<Key, Hash>::cend() const
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::cend() const
 {
-	size_t lastNonEmptyIdx;
-	for (int i = hashTable.size() - 1; i >= 0; i--)
-	{
-		if (!hashTable[i].empty())
-		{
-			lastNonEmptyIdx = i;
-			break;
-		}
-	}
-	auto& bucket = hashTable[lastNonEmptyIdx];
-	typename std::forward_list<Key>::const_iterator lastNonEmptyBucketIter = bucket.cbegin();
-	for (auto it = bucket.begin(); it != bucket.end(); it++)
-	{
-		typename forward_list<Key>::const_iterator iter = it;
-		iter++;
-		if (iter == bucket.end())
-			break;
-		lastNonEmptyBucketIter++;
-	}
-	return ConstIterator(*this, lastNonEmptyBucketIter);
+	return ConstIterator(this, hashTable.size(), typename Bucket::const_iterator());
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::Iterator UnorderedSet<Key, Hash>::begin()
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::begin()
 {
-	for (auto& bucket : hashTable) 
-	{
-		if (!bucket.empty())
-		{
-			return Iterator(bucket.begin());
-		}
-	}
-	return end();
+	ConstIterator first = cbegin();
+	if (first.bucketIndex == hashTable.size())
+		return end();
+
+	return Iterator(this, first.bucketIndex, hashTable[first.bucketIndex].begin());
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::Iterator UnorderedSet<Key, Hash>::end()
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::end()
 {
-	return Iterator(hashTable.back().end());
+	return Iterator(this, hashTable.size(), typename Bucket::iterator());
 }
 
-template<typename Key, typename Hash>
-double UnorderedSet<Key, Hash>::loadFactor() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+double UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::loadFactor() const
 {
-	int elementsCount = getElementsCount();
 	return static_cast<double>(elementsCount) / hashTable.size();
 }
 
-///////////////////////////////////////////////////////////////////////////////
-template<typename Key, typename Hash>
-UnorderedSet<Key, Hash>::ConstIterator::ConstIterator(const UnorderedSet& _set, typename forward_list<Key>::const_iterator curr) : set(_set)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+double UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::max_load_factor() const
 {
-	if (isLastElement(*curr))
-	{
-		size_t bucketIdx = set.getHashCode(*curr);
-		currElementIter = set.hashTable[bucketIdx].cend();
-		bucketIndex = -1;
-	}
-	else
-	{
-		currElementIter = curr;
-		bucketIndex = set.getHashCode(*curr);
-	}
+	return maxLoadFactor;
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::ConstIterator::isLastElementInBucket() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::max_load_factor(double ml)
 {
-	auto& bucket = set.hashTable[bucketIndex];
+	if (ml <= 0)
+		throw std::invalid_argument("The max load factor must be positive!");
+	if (minLoadFactor >= ml / 2)
+		throw std::invalid_argument("The max load factor must be more than twice the min load factor!");
+
+	maxLoadFactor = ml;
+	if (loadFactor() > maxLoadFactor)
+		rehash(0);
+}
 
-	for (auto it = bucket.cbegin(); it != bucket.cend(); it++)
-	{
-		if (*it == *currElementIter && (++it) == bucket.cend())
-			return true;
-	}
-	return false;
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+double UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::min_load_factor() const
+{
+	return minLoadFactor;
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::ConstIterator::isLastElementInHashTable() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::min_load_factor(double ml)
 {
-	if (!isLastElementInBucket())
-		return false;
+	//след смаляване натоварването е поне около max / 2, иначе всяко изтриване би преоразмерявало
+	if (ml < 0 || ml >= maxLoadFactor / 2)
+		throw std::invalid_argument("The min load factor must be in [0, max_load_factor() / 2)!");
 
-	for (int i = bucketIndex + 1; i < set.hashTable.size(); i++)
-	{
-		if (!set.hashTable[i].empty())
-			return false;
-	}
-	return true;
+	minLoadFactor = ml;
+	shrinkIfSparse();
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::ConstIterator::isFirstElementInBucket() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::shrink_to_fit()
 {
-	return currElementIter == set.hashTable[bucketIndex].cbegin();
+	rehash(0);
+	//rehash не заделя нова таблица, ако броят бъкети не се променя
+	if (hashTable.capacity() != hashTable.size())
+		resize(hashTable.size());
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::ConstIterator::isFirstElementInHashTable() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::memory_usage() const
 {
-	if (!isFirstElementInBucket())
-		return false;
+	//възел на forward_list е указател към следващия плюс самата стойност
+	struct ListNodeLayout
+	{
+		void* next;
+		Node node;
+	};
+
+	size_t bytes = sizeof(*this);
+	bytes += hashTable.capacity() * sizeof(Bucket);
+	bytes += elementsCount * sizeof(ListNodeLayout);
+
+	if constexpr (KeyHeapUsage<Key>::OWNS_HEAP)
+	{
+		for (const Bucket& bucket : hashTable)
+		{
+			for (const Node& node : bucket)
+				bytes += KeyHeapUsage<Key>::bytes(node.key);
+		}
+	}
 
-	for (int i = 0; i < bucketIndex; i++)
+	bytes += chainIndexes.capacity() * sizeof(unique_ptr<ChainIndex>);
+	for (const auto& index : chainIndexes)
 	{
-		if (!set.hashTable[i].empty())
-			return false;
+		if (index)
+			bytes += sizeof(ChainIndex) + index->capacity() * sizeof(typename ChainIndex::value_type);
 	}
-	return true;
+	return bytes;
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::ConstIterator::emptyBucket(size_t bucketIndex) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+size_t UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::bucket_count() const
 {
-	return set.hashTable[bucketIndex].empty();
+	return hashTable.size();
 }
 
-template<typename Key, typename Hash>
-int UnorderedSet<Key, Hash>::ConstIterator::lastNonEmptyBucketIndex() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::rehash(size_t bucketsCount)
 {
-	for (int i = set.hashTable.size() - 1; i >= 0; i--)
-	{
-		if (!set.hashTable[i].empty())
-			return i;
-	}
-	return -1;
+	size_t newBucketsCount = BucketPolicy::roundBucketsCount(max(bucketsCount, getBucketsCountFor(elementsCount)));
+
+	if (newBucketsCount != hashTable.size())
+		resize(newBucketsCount);
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::ConstIterator::isLastElement(const Key& key) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::reserve(size_t elements)
 {
-	size_t lastNonEmptyIdx = lastNonEmptyBucketIndex();
-	size_t keyIdx = set.getHashCode(key);
-	if (lastNonEmptyIdx != keyIdx)
-		return false;
+	rehash(getBucketsCountFor(elements));
+}
 
-	auto& bucket = set.hashTable[lastNonEmptyIdx];
-	for (auto it = bucket.begin(); it != bucket.end(); it++)
-	{
-		typename forward_list<Key>::const_iterator iter = it;
-		iter++;
-		if (iter == bucket.end() && *it == key)
-			return true;
-	}
-	return false;
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::randomizeHashSeed()
+{
+	random_device device;
+	hashSeed = (static_cast<size_t>(device()) << 16) ^ device();
+	if constexpr (sizeof(size_t) > 4)
+		hashSeed = (hashSeed << 32) ^ device();
+
+	resize(hashTable.size());
 }
 
-template<typename Key, typename Hash>
-const Key& UnorderedSet<Key, Hash>::ConstIterator::operator*() const
+///////////////////////////////////////////////////////////////////////////////
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::ConstIterator(const UnorderedSet* _set, size_t _bucketIndex, typename Bucket::const_iterator curr)
+	: set(_set), bucketIndex(_bucketIndex), currElementIter(curr)
 {
-	return *currElementIter;
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::ConstIterator UnorderedSet<Key, Hash>::ConstIterator::operator+(int off) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::ConstIterator(const Iterator& other)
+	: set(other.set), bucketIndex(other.bucketIndex), currElementIter(other.currElementIter)
 {
-	while (off != 0)
-	{
-		++this;
-		off--;
-	}
-	return ConstIterator(*this);
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::ConstIterator UnorderedSet<Key, Hash>::ConstIterator::operator-(int off) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::skipEmptyBuckets()
 {
-	while (off != 0)
+	while (currElementIter == set->hashTable[bucketIndex].cend())
 	{
-		--this;
-		off--;
+		bucketIndex++;
+		if (bucketIndex == set->hashTable.size())
+		{
+			currElementIter = typename Bucket::const_iterator();
+			return;
+		}
+		currElementIter = set->hashTable[bucketIndex].cbegin();
 	}
-	return ConstIterator(*this);
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::ConstIterator& UnorderedSet<Key, Hash>::ConstIterator::operator++()
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+const Key& UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::operator*() const
 {
-	if (isLastElementInHashTable())
-		return *this;
+	return currElementIter->key;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+const Key* UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::operator->() const
+{
+	return &currElementIter->key;
+}
 
-	if (isLastElementInBucket())
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::operator+(int off) const
+{
+	ConstIterator res = *this;
+	while (off > 0)
 	{
-		bucketIndex++;
-		while (emptyBucket(bucketIndex))
-		{
-			bucketIndex++;
-		}
-		currElementIter = set.hashTable[bucketIndex].cbegin();
+		++res;
+		off--;
 	}
-	else
+	while (off < 0)
 	{
-		currElementIter++;
+		--res;
+		off++;
 	}
+	return res;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::operator-(int off) const
+{
+	return *this + (-off);
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator& UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::operator++()
+{
+	if (bucketIndex == set->hashTable.size())
+		return *this;
+
+	++currElementIter;
+	skipEmptyBuckets();
 	return *this;
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::ConstIterator UnorderedSet<Key, Hash>::ConstIterator::operator++(int)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::operator++(int)
 {
 	ConstIterator temp = *this;
 	++(*this);
 	return temp;
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::ConstIterator& UnorderedSet<Key, Hash>::ConstIterator::operator--()
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator& UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::operator--()
 {
-	if (*this == set.cend())
+	//forward_list няма обратни връзки, затова предшественикът се търси в бъкета
+	if (bucketIndex < set->hashTable.size() && currElementIter != set->hashTable[bucketIndex].cbegin())
 	{
-		size_t lastBucketIdx = lastNonEmptyBucketIndex();
-		auto& bucket = set.hashTable[lastBucketIdx];
+		auto& bucket = set->hashTable[bucketIndex];
 		for (auto it = bucket.cbegin(); it != bucket.cend(); it++)
 		{
-			currElementIter = it;
+			auto nextIt = it;
+			if (++nextIt == currElementIter)
+			{
+				currElementIter = it;
+				break;
+			}
 		}
-		bucketIndex = lastBucketIdx;
 		return *this;
 	}
 
-	if (isFirstElementInHashTable())
-		return *this;
-
-	if (isFirstElementInBucket())
+	size_t prevBucketIndex = bucketIndex;
+	while (prevBucketIndex > 0)
 	{
-		bucketIndex--;
-		auto& bucket = set.hashTable[bucketIndex];
+		prevBucketIndex--;
+		auto& bucket = set->hashTable[prevBucketIndex];
+		if (bucket.empty())
+			continue;
 
-		auto iter = bucket.cbegin();
+		auto last = bucket.cbegin();
 		for (auto it = bucket.cbegin(); it != bucket.cend(); it++)
-			iter = it;
-
-		currElementIter = iter;
-	}
-	else
-	{
-		auto& bucket = set.hashTable[bucketIndex];
-		auto prev = bucket.before_begin();
-		for (auto it = bucket.begin(); it != bucket.end(); it++)
-		{
-			if (it == currElementIter)
-			{
-				currElementIter = prev;
-				break;
-			}
+			last = it;
 
-			prev = it;
-		}
+		bucketIndex = prevBucketIndex;
+		currElementIter = last;
+		return *this;
 	}
+	//сме на първия елемент
 	return *this;
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::ConstIterator UnorderedSet<Key, Hash>::ConstIterator::operator--(int)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::operator--(int)
 {
-	ConstIterator temp = *this; 
-	--(*this);               
+	ConstIterator temp = *this;
+	--(*this);
 	return temp;
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::ConstIterator::operator==(const ConstIterator& other) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::operator==(const ConstIterator& other) const
 {
-	return currElementIter == other.currElementIter && bucketIndex == other.bucketIndex;
+	return bucketIndex == other.bucketIndex && currElementIter == other.currElementIter;
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::ConstIterator::operator!=(const ConstIterator& other) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::ConstIterator::operator!=(const ConstIterator& other) const
 {
-	return currElementIter != other.currElementIter && bucketIndex == other.bucketIndex;
+	return !(*this == other);
 }
 
 ////////////////////////////////////////////////////////////////////////
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::Iterator::isLastElementInBucket() const
-{
-	auto& bucket = set.hashTable[bucketIndex];
-
-	for (auto it = bucket.begin(); it != bucket.end(); it++)
-	{
-		if (*it == *currElementIter && (++it) == bucket.end())
-			return true;
-	}
-	return false;
-}
-
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::Iterator::isLastElementInHashTable() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::Iterator(UnorderedSet* _set, size_t _bucketIndex, typename Bucket::iterator curr)
+	: set(_set), bucketIndex(_bucketIndex), currElementIter(curr)
 {
-	if (!isLastElementInBucket())
-		return false;
-
-	for (int i = bucketIndex + 1; i < set.hashTable.size(); i++)
-	{
-		if (!set.hashTable[i].empty())
-			return false;
-	}
-	return true;
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::Iterator::isFirstElementInHashTable() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+void UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::skipEmptyBuckets()
 {
-	if (!isFirstElementInBucket())
-		return false;
-
-	for (int i = 0; i < bucketIndex; i++)
+	while (currElementIter == set->hashTable[bucketIndex].end())
 	{
-		if (!set.hashTable[i].empty())
-			return false;
+		bucketIndex++;
+		if (bucketIndex == set->hashTable.size())
+		{
+			currElementIter = typename Bucket::iterator();
+			return;
+		}
+		currElementIter = set->hashTable[bucketIndex].begin();
 	}
-	return true;
-}
-
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::Iterator::isFirstElementInBucket() const
-{
-	return currElementIter == set.hashTable[bucketIndex].begin();
-}
-
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::Iterator::emptyBucket(size_t bucketIndex) const
-{
-	return set.hashTable[bucketIndex].empty();
 }
 
-template<typename Key, typename Hash>
-int UnorderedSet<Key, Hash>::Iterator::lastNonEmptyBucketIndex() const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+Key& UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::operator*() const
 {
-	for (int i = set.hashTable.size() - 1; i >= 0; i--)
-	{
-		if (!set.hashTable[i].empty())
-			return i;
-	}
-	return -1;
+	return currElementIter->key;
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::Iterator::isLastElement(const Key& key) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+Key* UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::operator->() const
 {
-	size_t lastNonEmptyIdx = lastNonEmptyBucketIndex();
-	size_t keyIdx = set.getHashCode(key);
-	if (lastNonEmptyIdx != keyIdx)
-		return false;
-
-	auto& bucket = set.hashTable[lastNonEmptyIdx];
-	for (auto it = bucket.begin(); it != bucket.end(); it++)
-	{
-		typename forward_list<Key>::iterator iter = it;
-		iter++;
-		if (iter == bucket.end() && *it == key)
-			return true;
-	}
-	return false;
+	return &currElementIter->key;
 }
 
-template<typename Key, typename Hash>
-UnorderedSet<Key, Hash>::Iterator::Iterator(const UnorderedSet& _set, typename forward_list<Key>::iterator curr) : set(_set)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::operator+(int off) const
 {
-	if (isLastElement(*curr))
-	{
-		size_t bucketIdx = set.getHashCode(*curr);
-		currElementIter = set.hashTable[bucketIdx].cend();
-		bucketIndex = -1;
-	}
-	else
+	Iterator res = *this;
+	while (off > 0)
 	{
-		currElementIter = curr;
-		bucketIndex = set.getHashCode(*curr);
+		++res;
+		off--;
 	}
-}
-
-template<typename Key, typename Hash>
-Key& UnorderedSet<Key, Hash>::Iterator::operator*() const
-{
-	return *currElementIter;
-}
-
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::Iterator UnorderedSet<Key, Hash>::Iterator::operator+(int off) const
-{
-	while (off != 0)
+	while (off < 0)
 	{
-		++this;
-		off--;
+		--res;
+		off++;
 	}
-	return Iterator(*this);
+	return res;
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::Iterator UnorderedSet<Key, Hash>::Iterator::operator-(int off) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::operator-(int off) const
 {
-	while (off != 0)
-	{
-		--this;
-		off--;
-	}
-	return Iterator(*this);
+	return *this + (-off);
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::Iterator& UnorderedSet<Key, Hash>::Iterator::operator--()
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator& UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::operator--()
 {
-	if (*this == set.cend())
-	{
-		size_t lastBucketIdx = lastNonEmptyBucketIndex();
-		auto& bucket = set.hashTable[lastBucketIdx];
-		for (auto it = bucket.begin(); it != bucket.end(); it++)
-		{
-			currElementIter = it;
-		}
-		bucketIndex = lastBucketIdx;
-		return *this;
-	}
-
-	if (isFirstElementInHashTable())
+	ConstIterator prev = --ConstIterator(*this);
+	if (prev.bucketIndex == bucketIndex && prev.currElementIter == currElementIter)
 		return *this;
 
-	if (isFirstElementInBucket())
-	{
-		bucketIndex--;
-		auto& bucket = set.hashTable[bucketIndex];
-
-		auto iter = bucket.begin();
-		for (auto it = bucket.begin(); it != bucket.end(); it++)
-			iter = it;
-
-		currElementIter = iter;
-	}
-	else
-	{
-		auto& bucket = set.hashTable[bucketIndex];
-		auto prev = bucket.before_begin();
-		for (auto it = bucket.begin(); it != bucket.end(); it++)
-		{
-			if (it == currElementIter)
-			{
-				currElementIter = prev;
-				break;
-			}
+	//връщаме се от const_iterator към iterator в същия бъкет
+	auto& bucket = set->hashTable[prev.bucketIndex];
+	auto it = bucket.begin();
+	while (typename Bucket::const_iterator(it) != prev.currElementIter)
+		it++;
 
-			prev = it;
-		}
-	}
+	bucketIndex = prev.bucketIndex;
+	currElementIter = it;
 	return *this;
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::Iterator UnorderedSet<Key, Hash>::Iterator::operator--(int)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::operator--(int)
 {
 	Iterator temp = *this;
 	--(*this);
 	return temp;
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::Iterator& UnorderedSet<Key, Hash>::Iterator::operator++()
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator& UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::operator++()
 {
-	if (isLastElementInHashTable())
+	if (bucketIndex == set->hashTable.size())
 		return *this;
 
-	if (isLastElementInBucket())
-	{
-		bucketIndex++;
-		while (emptyBucket(bucketIndex))
-		{
-			bucketIndex++;
-		}
-		currElementIter = set.hashTable[bucketIndex].cbegin();
-	}
-	else
-	{
-		currElementIter++;
-	}
+	++currElementIter;
+	skipEmptyBuckets();
 	return *this;
 }
 
-template<typename Key, typename Hash>
-typename UnorderedSet<Key, Hash>::Iterator UnorderedSet<Key, Hash>::Iterator::operator++(int)
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+typename UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::operator++(int)
 {
 	Iterator temp = *this;
 	++(*this);
 	return temp;
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::Iterator::operator==(const Iterator& other) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::operator==(const Iterator& other) const
+{
+	return bucketIndex == other.bucketIndex && currElementIter == other.currElementIter;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::Iterator::operator!=(const Iterator& other) const
+{
+	return !(*this == other);
+}
+
+////////////////////////////////////////////////////////////////////////
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+bool UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::NodeHandle::empty() const
+{
+	return node.empty();
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::NodeHandle::operator bool() const
 {
-	return currElementIter == other.currElementIter && bucketIndex == other.bucketIndex;
+	return !node.empty();
 }
 
-template<typename Key, typename Hash>
-bool UnorderedSet<Key, Hash>::Iterator::operator!=(const Iterator& other) const
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+Key& UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::NodeHandle::value()
 {
-	return currElementIter != other.currElementIter && bucketIndex == other.bucketIndex;
-}
\ No newline at end of file
+	return node.front().key;
+}
+
+template<typename Key, typename Hash, typename KeyEqual, typename BucketPolicy>
+const Key& UnorderedSet<Key, Hash, KeyEqual, BucketPolicy>::NodeHandle::value() const
+{
+	return node.front().key;
+}